@@ -0,0 +1,69 @@
+//
+//  ECAllocStats.cpp
+//
+
+#include "ECAllocStats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#define EC_ALLOC_SIZE(p) _msize(p)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define EC_ALLOC_SIZE(p) malloc_size(p)
+#else
+#include <malloc.h>
+#define EC_ALLOC_SIZE(p) malloc_usable_size(p)
+#endif
+
+static std::atomic<long long> numAllocs(0);
+static std::atomic<long long> bytesInUse(0);
+static std::atomic<long long> peakBytes(0);
+
+long long ECAllocStats::GetNumAllocs() { return numAllocs.load(std::memory_order_relaxed); }
+long long ECAllocStats::GetBytesInUse() { return bytesInUse.load(std::memory_order_relaxed); }
+long long ECAllocStats::GetPeakBytes() { return peakBytes.load(std::memory_order_relaxed); }
+void ECAllocStats::ResetPeak() { peakBytes.store(bytesInUse.load(std::memory_order_relaxed), std::memory_order_relaxed); }
+
+static void* CountedAlloc(size_t size)
+{
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) { return nullptr; }
+    numAllocs.fetch_add(1, std::memory_order_relaxed);
+    long long inUse = bytesInUse.fetch_add((long long)EC_ALLOC_SIZE(p), std::memory_order_relaxed) + (long long)EC_ALLOC_SIZE(p);
+    long long peak = peakBytes.load(std::memory_order_relaxed);
+    while (inUse > peak && !peakBytes.compare_exchange_weak(peak, inUse, std::memory_order_relaxed)) {}
+    return p;
+}
+
+static void CountedFree(void* p)
+{
+    if (p == nullptr) { return; }
+    bytesInUse.fetch_sub((long long)EC_ALLOC_SIZE(p), std::memory_order_relaxed);
+    std::free(p);
+}
+
+void* operator new(size_t size)
+{
+    void* p = CountedAlloc(size);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    void* p = CountedAlloc(size);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { CountedFree(p); }
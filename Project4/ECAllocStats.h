@@ -0,0 +1,25 @@
+//
+//  ECAllocStats.h
+//
+
+#ifndef ECAllocStats_h
+#define ECAllocStats_h
+
+#include <cstddef>
+
+//*****************************************************************************
+// Heap usage counters for benchmarks
+// ECAllocStats.cpp replaces the global operator new/delete with versions that count
+// allocations and track bytes in use (and the peak since the last ResetPeak). That taxes every
+// allocation in the program, so only the benchmark target (Project4Bench) links it, never Project4
+
+class ECAllocStats
+{
+public:
+    static long long GetNumAllocs(); //since program start
+    static long long GetBytesInUse();
+    static long long GetPeakBytes(); //highest GetBytesInUse since the last ResetPeak
+    static void ResetPeak(); //peak = bytes in use now
+};
+
+#endif /* ECAllocStats_h */
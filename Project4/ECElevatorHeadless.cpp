@@ -0,0 +1,88 @@
+//
+//  ECElevatorHeadless.cpp
+//
+
+#include "ECElevatorHeadless.h"
+#include <iomanip>
+
+using namespace std;
+
+ECElevatorResultCollector::ECElevatorResultCollector(ECElevatorRequestSource& source, std::ostream* perRequest) : source(source), perRequest(perRequest) {}
+
+bool ECElevatorResultCollector::Next(ECElevatorSimRequest& req)
+{
+    return source.Next(req);
+}
+
+int ECElevatorResultCollector::Skip(int num)
+{
+    return source.Skip(num);
+}
+
+void ECElevatorResultCollector::OnUpdate(int reqIndex, const ECElevatorSimRequest& req)
+{
+    source.OnUpdate(reqIndex, req);
+    if (!req.IsServiced()) { return; } //only boarded
+
+    int journey = req.GetArriveTime() - req.GetTime();
+    numServiced++;
+    sumJourney += journey;
+    if (journey > maxJourney) { maxJourney = journey; }
+    if (perRequest != nullptr) { PrintRequest(*perRequest, reqIndex, req.GetTime(), req.GetFloorSrc(), req.GetFloorDest(), req.GetArriveTime()); }
+}
+
+void ECElevatorResultCollector::PrintHeader(std::ostream& out)
+{
+    out << "index,time,floorSrc,floorDest,arriveTime,journeyTime" << '\n';
+}
+
+void ECElevatorResultCollector::PrintRequest(std::ostream& out, int reqIndex, int time, int floorSrc, int floorDest, int arriveTime)
+{
+    out << reqIndex << ',' << time << ',' << floorSrc << ',' << floorDest << ',' << arriveTime << ',' << (arriveTime >= 0 ? arriveTime - time : -1) << '\n';
+}
+
+void ECElevatorResultCollector::PrintUnfinished(const ECElevatorSim& sim) const
+{
+    if (perRequest == nullptr) { return; }
+    const ECElevatorRequestStore& store = sim.GetRequests();
+    for (int i = 0; i < store.GetSize(); i++)
+    {
+        if (store.IsServiced(i)) { continue; } //retired slot
+        PrintRequest(*perRequest, store.GetId(i), store.GetTime(i), store.GetFloorSrc(i), store.GetFloorDest(i), -1);
+    }
+}
+
+void ECElevatorResultCollector::PrintTimes(std::ostream& out, const char* label, const ECLatencyHistogram& times)
+{
+    out << label << setw(6) << times.GetPercentile(50) << setw(9) << times.GetPercentile(90) << setw(9) << times.GetPercentile(99)
+        << setw(9) << times.GetMax() << setw(9) << times.GetMean() << '\n';
+}
+
+void ECElevatorResultCollector::PrintSummary(std::ostream& out, const ECElevatorSim& sim, int lenSim, double elapsedMs) const
+{
+    ECElevatorServiceStats stats = sim.GetServiceStats(); //the simulator's own counts also cover what happened before a restored checkpoint
+    long long numServiced = stats.GetNumServiced();
+    long long numUnfinished = sim.GetRequests().GetNumInUse();
+    out << "floors:            " << sim.GetNumFloors() << '\n';
+    out << "cars:              " << sim.GetNumCars() << '\n';
+    out << "direction policy:  " << ECElevatorDirectionPolicy::GetName(sim.GetDirectionPolicy().GetType()) << '\n';
+    out << "ticks simulated:   " << lenSim << '\n';
+    long long numMade = sim.GetNumRequestsMade(); //not the one the simulator has read ahead
+    out << "requests read:     " << numMade << '\n';
+    out << "  serviced:        " << numServiced << '\n';
+    out << "  unfinished:      " << numUnfinished << '\n';
+    out << "  ignored:         " << numMade - numServiced - numUnfinished << " (floor out of range, or already serviced)" << '\n';
+    out << fixed << setprecision(2);
+    out << "journey time avg:  " << stats.GetJourney().GetMean() << '\n';
+    out << "journey time max:  " << stats.GetJourney().GetMax() << '\n';
+    out << "                     p50      p90      p99      max     mean" << '\n';
+    PrintTimes(out, "wait time:         ", stats.GetWait());
+    PrintTimes(out, "in-car time:       ", stats.GetRide());
+    PrintTimes(out, "journey time:      ", stats.GetJourney());
+    for (int c = 0; c < sim.GetNumCars(); c++)
+    {
+        const ECElevatorCar& car = sim.GetCar(c);
+        out << "car " << setw(2) << c << " floor/dir:  " << car.GetFloor() << " " << (car.GetDir() == EC_ELEVATOR_UP ? "up" : (car.GetDir() == EC_ELEVATOR_DOWN ? "down" : "stopped")) << '\n';
+    }
+    out << "wall time:         " << elapsedMs << " ms" << endl;
+}
@@ -0,0 +1,51 @@
+//
+//  ECElevatorHeadless.h
+//
+
+#ifndef ECElevatorHeadless_h
+#define ECElevatorHeadless_h
+
+#include "ECElevatorSim.h"
+#include <iostream>
+
+//*****************************************************************************
+// Results of a run without the GUI
+// Sits between the simulator and the real request source and tallies each request as it is
+// serviced (optionally printing it right away), so nothing per request is kept and any trace
+// length works. How many requests were made comes from the simulator (GetNumRequestsMade), which
+// reads one ahead of what it has made
+
+class ECElevatorResultCollector : public ECElevatorRequestSource
+{
+public:
+    // perRequest: where to print one CSV line per serviced request (nullptr for none)
+    ECElevatorResultCollector(ECElevatorRequestSource& source, std::ostream* perRequest = nullptr);
+
+    virtual bool Next(ECElevatorSimRequest& req) override;
+    virtual void OnUpdate(int reqIndex, const ECElevatorSimRequest& req) override;
+    virtual int Skip(int num) override;
+
+    long long GetNumServiced() const { return numServiced; }
+    double GetAvgJourney() const { return numServiced > 0 ? (double)sumJourney / numServiced : 0.0; }
+    int GetMaxJourney() const { return maxJourney; }
+
+    // Requests still in flight when the simulation stopped, in the same CSV format (arrive time -1)
+    void PrintUnfinished(const ECElevatorSim& sim) const;
+
+    // Counts (serviced ones from the simulator, so they include any restored checkpoint), journey times (request made -> arrived), wait/in-car/journey percentiles, plus where each car ended up
+    void PrintSummary(std::ostream& out, const ECElevatorSim& sim, int lenSim, double elapsedMs) const;
+
+    static void PrintHeader(std::ostream& out); //column names of the per-request lines
+
+private:
+    static void PrintTimes(std::ostream& out, const char* label, const ECLatencyHistogram& times); //one row of percentiles
+    static void PrintRequest(std::ostream& out, int reqIndex, int time, int floorSrc, int floorDest, int arriveTime);
+
+    ECElevatorRequestSource& source;
+    std::ostream* perRequest;
+    long long numServiced = 0;
+    long long sumJourney = 0;
+    int maxJourney = 0;
+};
+
+#endif /* ECElevatorHeadless_h */
@@ -0,0 +1,58 @@
+//
+//  ECElevatorLiveSource.cpp
+//
+
+#include "ECElevatorLiveSource.h"
+#include <chrono>
+#include <climits>
+
+using namespace std;
+
+ECElevatorLiveSource::ECElevatorLiveSource(int capacity, bool multiProducer) :
+    multiProducer(multiProducer), spsc(multiProducer ? 1 : capacity), mpsc(multiProducer ? capacity : 1)
+{
+    collected.reserve(spsc.GetCapacity() + mpsc.GetCapacity());
+}
+
+long long ECElevatorLiveSource::NowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ECElevatorLiveSource::Push(int floorSrc, int floorDest)
+{
+    Call call{ floorSrc, floorDest, NowNs() };
+    if (multiProducer ? mpsc.TryPush(call) : spsc.TryPush(call)) { return true; }
+    numDropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+int ECElevatorLiveSource::Collect(int tm)
+{
+    //drop what was handed out, moving the unread calls to the front, so the buffer never outgrows its reserve
+    collected.erase(collected.begin(), collected.begin() + nextCollected);
+    nextCollected = 0;
+    tmCollect = max(tmCollect, tm); //requests go out in time order
+
+    //only what is in the ring now (anything pushed from here on is for the next Collect), and no more
+    //than the buffer has room for; the rest waits in the ring
+    size_t numCollected = 0, numReady = multiProducer ? mpsc.GetSize() : spsc.GetSize();
+    numReady = min(numReady, collected.capacity() - collected.size());
+    Call call;
+    while (numCollected < numReady && (multiProducer ? mpsc.TryPop(call) : spsc.TryPop(call)))
+    {
+        collected.push_back(CollectedCall{ call, tmCollect });
+        numCollected++;
+    }
+    return (int)numCollected;
+}
+
+bool ECElevatorLiveSource::Next(ECElevatorSimRequest& req)
+{
+    if (nextCollected == collected.size()) { return false; } //nothing until the next Collect
+    const CollectedCall& next = collected[nextCollected++];
+    req = ECElevatorSimRequest(next.time, next.call.floorSrc, next.call.floorDest);
+    long long ns = NowNs() - next.call.nsPushed;
+    latency.Record(ns > INT_MAX ? INT_MAX : (int)ns);
+    return true;
+}
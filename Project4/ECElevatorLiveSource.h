@@ -0,0 +1,73 @@
+//
+//  ECElevatorLiveSource.h
+//
+
+#ifndef ECElevatorLiveSource_h
+#define ECElevatorLiveSource_h
+
+#include "ECElevatorSim.h"
+#include "ECLockFreeQueue.h"
+#include <atomic>
+#include <vector>
+
+//*****************************************************************************
+// Hall calls pushed from other threads (e.g. a live building feed) while the simulation runs
+// Producers push into a lock-free ring and never wait on the simulation thread. The simulation
+// thread takes the calls at tick boundaries:
+//
+//     live.Collect(sim.GetCurrTime());
+//     sim.Step();
+//
+// Collect stamps everything pushed so far with that tick; a call pushed while the tick runs waits
+// for the next Collect. So which tick a call lands on depends only on when it was pushed relative
+// to the boundaries, never on how far into the tick the simulator was when it read the queue.
+// Each call's latency from Push to being handed to the simulator (which dispatches it to a car in
+// that same step) is kept, in nanoseconds
+
+class ECElevatorLiveSource : public ECElevatorRequestSource
+{
+public:
+    // capacity: calls that can wait between two Collects; multiProducer: false if only one thread ever pushes (cheaper)
+    ECElevatorLiveSource(int capacity = 4096, bool multiProducer = true);
+
+    // Producer side: false if the queue is full (the call is dropped and counted)
+    bool Push(int floorSrc, int floorDest);
+
+    // Simulation thread: take what has been pushed as made at tick tm (not before the last Collect's); returns how many.
+    // Calls Next hasn't handed out yet stay ahead of them; if capacity calls are still unread the new ones wait in the ring
+    int Collect(int tm);
+
+    virtual bool Next(ECElevatorSimRequest& req) override;
+
+    long long GetNumDropped() const { return numDropped.load(std::memory_order_relaxed); }
+    const ECLatencyHistogram& GetLatency() const { return latency; } //simulation thread only
+
+private:
+    struct Call
+    {
+        int floorSrc;
+        int floorDest;
+        long long nsPushed;
+    };
+
+    struct CollectedCall
+    {
+        Call call;
+        int time;
+    };
+
+    static long long NowNs();
+
+    bool multiProducer;
+    ECSpscQueue<Call> spsc; //only the one in use gets the capacity
+    ECMpscQueue<Call> mpsc;
+    std::atomic<long long> numDropped{ 0 };
+
+    //simulation thread's side
+    std::vector<CollectedCall> collected;
+    size_t nextCollected = 0;
+    int tmCollect = 0;
+    ECLatencyHistogram latency;
+};
+
+#endif /* ECElevatorLiveSource_h */
@@ -4,19 +4,36 @@
 
 
 #include "ECElevatorSim.h"
+#include "ECFloorKernels.h"
+#include <algorithm>
+#include <iterator>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
 
 using namespace std;
 
-ECElevatorMovement::ECElevatorMovement(EC_ELEVATOR_DIR direc) : direction(EC_ELEVATOR_STOPPED) {} //initialize as stopped by default
+ECElevatorMovement::ECElevatorMovement(EC_ELEVATOR_DIR direc) : direction(direc) {}
+
+const ECElevatorMovement& ECElevatorMovement::ForDirection(EC_ELEVATOR_DIR direc)
+{
+    if (direc == EC_ELEVATOR_UP) { return ECElevatorMovementUp::Instance(); }
+    if (direc == EC_ELEVATOR_DOWN) { return ECElevatorMovementDown::Instance(); }
+    return ECElevatorMovementStop::Instance();
+}
 
 ECElevatorMovementUp::ECElevatorMovementUp() : ECElevatorMovement(EC_ELEVATOR_UP) {}
-void ECElevatorMovementUp::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) { floor++; } //UP so increace currFloor
+void ECElevatorMovementUp::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const { floor++; } //UP so increace currFloor
+const ECElevatorMovementUp& ECElevatorMovementUp::Instance() { static const ECElevatorMovementUp up; return up; }
 
 ECElevatorMovementDown::ECElevatorMovementDown() : ECElevatorMovement(EC_ELEVATOR_DOWN) {}
-void ECElevatorMovementDown::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) { floor--; } //DOWN so decreace currFloor
+void ECElevatorMovementDown::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const { floor--; } //DOWN so decreace currFloor
+const ECElevatorMovementDown& ECElevatorMovementDown::Instance() { static const ECElevatorMovementDown down; return down; }
 
 ECElevatorMovementStop::ECElevatorMovementStop() : ECElevatorMovement(EC_ELEVATOR_STOPPED) {}
-void ECElevatorMovementStop::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) //STOP so must determine which direction to go to next
+const ECElevatorMovementStop& ECElevatorMovementStop::Instance() { static const ECElevatorMovementStop stop; return stop; }
+void ECElevatorMovementStop::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const //STOP so must determine which direction to go to next
 {
     if (!req.IsServiced() && req.IsFloorRequestDone() && req.GetFloorDest() == floor && currTime >= req.GetTime()) //check if passenger inside requested to be dropped on this floor
     {
@@ -29,201 +46,1208 @@ void ECElevatorMovementStop::ChangeDirection(ECElevatorSimRequest& req, EC_ELEVA
     }
 }
 
-ECElevatorSim::ECElevatorSim(int numFloors, std::vector<ECElevatorSimRequest>& listRequests) : numFloors(numFloors), currFloor(1), currDir(EC_ELEVATOR_STOPPED), requests(listRequests) {} //start at floor 1 and initialize as stopped initially
+ECElevatorDemandIndex::ECElevatorDemandIndex(int numFloors) : hallUp(numFloors + 1, 0), hallDown(numFloors + 1, 0), carCalls(numFloors + 1, 0), reqsAtFloor(numFloors + 1) {} //floors 1..numFloors, slot 0 unused
 
-void ECElevatorSim::Simulate(int lenSim)
+void ECElevatorDemandIndex::Clear()
 {
-    for (auto tm = 0; tm < lenSim; tm++) //simulate time
+    std::fill(hallUp.begin(), hallUp.end(), 0);
+    std::fill(hallDown.begin(), hallDown.end(), 0);
+    std::fill(carCalls.begin(), carCalls.end(), 0);
+    for (auto& reqs : reqsAtFloor)
     {
-        RecordState(tm);
-        
-        UpdateDirectionAtTime(tm);
+        reqs.clear();
+    }
+    floorsWithDemand.clear();
+}
 
-        //create approproate class object and invoke method to update floor
-        if (currDir == EC_ELEVATOR_DOWN)
-        {
-            ECElevatorMovementDown* down = new ECElevatorMovementDown;
-            UpdateElevatorMovement(down, tm);
+void ECElevatorDemandIndex::AddHallCall(int floor, bool goingUp, int reqIndex)
+{
+    (goingUp ? hallUp : hallDown)[floor]++;
+    AddRequest(floor, reqIndex);
+}
 
-        }
-        else if (currDir == EC_ELEVATOR_UP)
-        {
-            ECElevatorMovementUp* up = new ECElevatorMovementUp;
-            UpdateElevatorMovement(up, tm);
-        }
-        else //whenever we stop, we must update variables and times for passangers being dropped off or picked up
+void ECElevatorDemandIndex::RemoveHallCall(int floor, bool goingUp, int reqIndex)
+{
+    (goingUp ? hallUp : hallDown)[floor]--;
+    RemoveRequest(floor, reqIndex);
+}
+
+void ECElevatorDemandIndex::AddCarCall(int floor, int reqIndex)
+{
+    carCalls[floor]++;
+    AddRequest(floor, reqIndex);
+}
+
+void ECElevatorDemandIndex::RemoveCarCall(int floor, int reqIndex)
+{
+    carCalls[floor]--;
+    RemoveRequest(floor, reqIndex);
+}
+
+void ECElevatorDemandIndex::AddRequest(int floor, int reqIndex)
+{
+    if (reqsAtFloor[floor].empty()) { floorsWithDemand.insert(floor); } //first request for this floor
+    reqsAtFloor[floor].insert(reqIndex);
+}
+
+void ECElevatorDemandIndex::RemoveRequest(int floor, int reqIndex)
+{
+    reqsAtFloor[floor].erase(reqIndex);
+    if (reqsAtFloor[floor].empty()) { floorsWithDemand.erase(floor); } //nobody needs this floor anymore
+}
+
+int ECElevatorDemandIndex::DistanceAhead(int floor, EC_ELEVATOR_DIR dir) const
+{
+    if (dir == EC_ELEVATOR_UP)
+    {
+        auto it = floorsWithDemand.upper_bound(floor);
+        return it == floorsWithDemand.end() ? 0 : *it - floor;
+    }
+    if (dir == EC_ELEVATOR_DOWN)
+    {
+        auto it = floorsWithDemand.lower_bound(floor);
+        return it == floorsWithDemand.begin() ? 0 : floor - *std::prev(it);
+    }
+    return 0;
+}
+
+int ECElevatorDemandIndex::FindClosest(int floor) const
+{
+    if (AnyAt(floor)) { return floor; }
+
+    auto itAbove = floorsWithDemand.upper_bound(floor);
+    auto itBelow = floorsWithDemand.lower_bound(floor);
+    bool hasAbove = itAbove != floorsWithDemand.end();
+    bool hasBelow = itBelow != floorsWithDemand.begin();
+    if (!hasAbove && !hasBelow) { return floor; }
+    if (!hasBelow) { return *itAbove; }
+    int below = *std::prev(itBelow);
+    if (!hasAbove) { return below; }
+
+    int above = *itAbove;
+    if (above - floor != floor - below) { return above - floor < floor - below ? above : below; }
+    return *reqsAtFloor[above].begin() < *reqsAtFloor[below].begin() ? above : below; //same distance: whoever asked first
+}
+
+ECElevatorHistory::ECElevatorHistory(int keyframeEvents) : keyframeEvents(keyframeEvents)
+{
+    keyframes.push_back(Keyframe{ 0, ECElevatorState{ 1, EC_ELEVATOR_STOPPED } }); //empty building before any event
+}
+
+void ECElevatorHistory::RecordArrival(int reqIndex, int floorSrc, int floorDest) { AddEvent(EV_ARRIVE, reqIndex, floorSrc, floorDest); }
+void ECElevatorHistory::RecordBoarding(int reqIndex, int floorSrc, int floorDest) { AddEvent(EV_BOARD, reqIndex, floorSrc, floorDest); }
+void ECElevatorHistory::RecordAlighting(int reqIndex, int floorSrc, int floorDest) { AddEvent(EV_ALIGHT, reqIndex, floorSrc, floorDest); }
+
+void ECElevatorHistory::AddEvent(EventType type, int reqIndex, int floorSrc, int floorDest)
+{
+    if (!recording) { return; }
+    Event ev{}; //zeroed, padding included, so checkpoints of the same run are byte for byte the same
+    ev.reqIndex = reqIndex;
+    ev.floorSrc = (short)floorSrc;
+    ev.floorDest = (short)floorDest;
+    ev.type = (unsigned char)type;
+    events.push_back(ev);
+}
+
+void ECElevatorHistory::RecordSpan(int tmStart, int tmEnd, int floorStart, EC_ELEVATOR_DIR dir, int step)
+{
+    if (!recording)
+    {
+        numTicks = tmEnd;
+        return;
+    }
+
+    int len = tmEnd - tmStart;
+    if (len == 1) { step = 0; } //a single tick has no step of its own
+
+    //extend the last run if nothing happened in between and the floor keeps changing the same way
+    bool eventsPending = runs.empty() || (int)events.size() > runs.back().eventEnd;
+    if (!eventsPending && runs.back().dir == dir)
+    {
+        const Run& run = runs.back();
+        int runLen = numTicks - run.tmStart;
+        int runStep = runLen == 1 ? floorStart - run.floorStart : run.step;
+        if (runStep >= -1 && runStep <= 1 && floorStart == run.floorStart + runStep * runLen && (len == 1 || step == runStep))
         {
-            ECElevatorMovementStop* stop = new ECElevatorMovementStop;
-            for (auto& reqs : requests) //loop through each request and mark each as done if they are done (see Stopped class)
-            {
-                stop->ChangeDirection(reqs, currDir, currFloor, tm);
-            }
+            if (run.step != runStep) { runs.MutableBack().step = runStep; } //the last chunk is this log's own (see ECSharedLog), so this never touches a fork
+            numTicks = tmEnd;
+            return;
         }
-        
-        prevMove = GetCurrDir();
     }
+
+    //take a keyframe once enough events piled up since the last one
+    if ((int)events.size() - keyframes.back().eventEnd >= keyframeEvents)
+    {
+        Keyframe kf{ (int)events.size(), keyframes.back().state };
+        ApplyEvents(kf.state, keyframes.back().eventEnd, kf.eventEnd);
+        keyframes.push_back(kf);
+    }
+
+    runs.push_back(Run{ tmStart, floorStart, step, dir, (int)events.size() });
+    numTicks = tmEnd;
 }
 
-//are there any requests in the direction you're currently going?
-bool ECElevatorSim::anyDirReqs(EC_ELEVATOR_DIR move, int time) const
+int ECElevatorHistory::FindRun(int tm) const
+{
+    //last run starting at or before tm
+    size_t lo = 0, hi = runs.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (runs[mid].tmStart <= tm) { lo = mid + 1; }
+        else { hi = mid; }
+    }
+    return (int)lo - 1;
+}
+
+int ECElevatorHistory::GetFloor(int tm) const
 {
-    for (auto& req : requests)
+    const Run& run = runs[FindRun(tm)];
+    return run.floorStart + run.step * (tm - run.tmStart);
+}
+
+const ECElevatorState& ECElevatorHistory::GetState(int tm) const
+{
+    const Run& run = runs[FindRun(tm)];
+
+    //roll the cached state forward when it is close behind, otherwise start over from the last keyframe
+    if (cachedEventEnd < 0 || cachedEventEnd > run.eventEnd || run.eventEnd - cachedEventEnd > keyframeEvents)
     {
-        if (req.GetTime() <= time && !req.IsServiced())
+        size_t lo = 0, hi = keyframes.size(); //last keyframe at or before the run's events
+        while (lo < hi)
         {
-            if ((move == EC_ELEVATOR_UP && req.GetRequestedFloor() > currFloor) || (move == EC_ELEVATOR_DOWN && req.GetRequestedFloor() < currFloor)) //request is in current direction
-            {
-                return true;
-            }
+            size_t mid = (lo + hi) / 2;
+            if (keyframes[mid].eventEnd <= run.eventEnd) { lo = mid + 1; }
+            else { hi = mid; }
         }
+        const Keyframe& kf = keyframes[lo - 1];
+        cachedState = kf.state;
+        cachedEventEnd = kf.eventEnd;
     }
-    return false;
+    ApplyEvents(cachedState, cachedEventEnd, run.eventEnd);
+    cachedEventEnd = run.eventEnd;
+
+    cachedState.floor = run.floorStart + run.step * (tm - run.tmStart);
+    cachedState.dir = run.dir;
+    return cachedState;
 }
 
-//are there any requests on currFloor?
-bool ECElevatorSim::anyFloorReq(int const time, int currFloor) const
+void ECElevatorHistory::Save(ECSnapshotWriter& out) const
 {
-    for (auto& req : requests)
+    std::vector<int> keyframeEnds;
+    for (size_t k = 0; k < keyframes.size(); k++)
     {
-        if (req.GetTime() <= time && req.GetRequestedFloor() == currFloor) { return true; }
+        keyframeEnds.push_back(keyframes[k].eventEnd);
     }
-    return false;
+    out.Put(keyframeEvents);
+    out.Put(recording);
+    out.Put(numTicks);
+    runs.Save(out);
+    events.Save(out);
+    out.PutVector(keyframeEnds);
 }
 
-void ECElevatorSim::handleDirectionChangeHelper(ECElevatorSimRequest requestParameter)
+//checkpoints hold directions as the enum's raw bytes; look at them as a plain integer so garbage is
+//caught before it is ever used as a direction
+static bool IsValidDir(const EC_ELEVATOR_DIR& dir)
 {
-    if (requestParameter.GetRequestedFloor() < currFloor) { SetCurrDir(EC_ELEVATOR_DOWN); } //go down if needed
-    else if (requestParameter.GetRequestedFloor() > currFloor) { SetCurrDir(EC_ELEVATOR_UP); } //go up if needed
-    else { SetCurrDir(EC_ELEVATOR_STOPPED); } //else stop
+    std::underlying_type<EC_ELEVATOR_DIR>::type value;
+    memcpy(&value, &dir, sizeof(value));
+    return (long long)value >= EC_ELEVATOR_STOPPED && (long long)value <= EC_ELEVATOR_DOWN;
 }
 
-void ECElevatorSim::handleDirectionChange(int time)
+void ECElevatorHistory::Load(ECSnapshotReader& in, int numFloors)
 {
-    for (auto& req : requests)
+    std::vector<int> keyframeEnds;
+    keyframeEvents = in.Get<int>();
+    recording = in.Get<bool>();
+    numTicks = in.Get<int>();
+    runs.Load(in);
+    events.Load(in);
+    in.GetVector(keyframeEnds);
+
+    //the first keyframe is the empty building; the others are rebuilt by replaying the events before them
+    bool valid = in.IsOk() && keyframeEvents > 0 && !keyframeEnds.empty() && keyframeEnds[0] == 0 && (numTicks == 0 || !runs.empty() || !recording);
+    for (size_t k = 1; valid && k < keyframeEnds.size(); k++)
+    {
+        valid = keyframeEnds[k] >= keyframeEnds[k - 1] && keyframeEnds[k] <= (int)events.size();
+    }
+    auto validFloor = [numFloors](long long floor) { return floor >= 1 && floor <= numFloors; };
+    for (size_t r = 0; valid && r < runs.size(); r++)
     {
-        if (req.GetTime() <= time && !req.IsServiced() && !req.IsFloorRequestDone()) //if user has not been picked up yet
+        const Run& run = runs[r];
+        long long tmLast = r + 1 < runs.size() ? runs[r + 1].tmStart - 1LL : numTicks - 1LL; //the run's last tick
+        valid = run.eventEnd >= 0 && run.eventEnd <= (int)events.size() && run.tmStart >= 0 && run.tmStart < numTicks
+            && (r == 0 || (run.tmStart > runs[r - 1].tmStart && run.eventEnd >= runs[r - 1].eventEnd))
+            && IsValidDir(run.dir)
+            && run.step >= -1 && run.step <= 1 && validFloor(run.floorStart) && validFloor(run.floorStart + run.step * (tmLast - run.tmStart));
+    }
+
+    //every event must make sense where it is: a known type, floors in the building, and boarding or
+    //getting off only for someone who is waiting at that floor or is on board
+    std::map<int, int> present; //reqIndex -> floor waiting at, or 0 once on board
+    for (size_t e = 0; valid && e < events.size(); e++)
+    {
+        const Event& ev = events[e];
+        auto it = present.find(ev.reqIndex);
+        valid = ev.reqIndex >= 0 && validFloor(ev.floorSrc) && validFloor(ev.floorDest);
+        if (!valid) { break; }
+        if (ev.type == EV_ARRIVE)
+        {
+            valid = it == present.end();
+            if (valid) { present[ev.reqIndex] = ev.floorSrc; }
+        }
+        else if (ev.type == EV_BOARD)
+        {
+            valid = it != present.end() && it->second == ev.floorSrc;
+            if (valid) { it->second = 0; }
+        }
+        else if (ev.type == EV_ALIGHT)
+        {
+            valid = it != present.end() && it->second == 0;
+            if (valid) { present.erase(it); }
+        }
+        else { valid = false; }
+    }
+
+    Keyframe empty = keyframes[0];
+    keyframes.clear();
+    keyframes.push_back(empty);
+    if (!valid)
+    {
+        in.Fail();
+        return;
+    }
+    for (size_t k = 1; k < keyframeEnds.size(); k++)
+    {
+        Keyframe kf{ keyframeEnds[k], keyframes.back().state };
+        if (!ApplyEvents(kf.state, keyframes.back().eventEnd, kf.eventEnd))
+        {
+            keyframes.clear();
+            keyframes.push_back(empty);
+            in.Fail();
+            return;
+        }
+        keyframes.push_back(kf);
+    }
+    cachedEventEnd = -1;
+}
+
+//false if an event boards or drops off someone who isn't there (the state is then half updated)
+bool ECElevatorHistory::ApplyEvents(ECElevatorState& state, int eventBegin, int eventEnd) const
+{
+    auto byIndex = [](const RequestInfoAtTime& a, const RequestInfoAtTime& b) { return a.reqIndex < b.reqIndex; };
+    auto erase = [](std::vector<RequestInfoAtTime>& list, int reqIndex) {
+        auto it = std::find_if(list.begin(), list.end(), [reqIndex](const RequestInfoAtTime& info) { return info.reqIndex == reqIndex; });
+        if (it == list.end()) { return false; }
+        list.erase(it);
+        return true;
+    };
+
+    for (int e = eventBegin; e < eventEnd; e++)
+    {
+        const Event& ev = events[e];
+        RequestInfoAtTime info{ ev.reqIndex, ev.floorDest, ev.floorDest >= ev.floorSrc };
+        if (ev.type == EV_ARRIVE) //starts waiting at floorSrc
+        {
+            auto& waiting = state.waitingMap[ev.floorSrc];
+            waiting.insert(std::upper_bound(waiting.begin(), waiting.end(), info, byIndex), info);
+        }
+        else if (ev.type == EV_BOARD) //leaves floorSrc and gets in the cabin
         {
-            SetCurrDir(req.GetRequestedFloor() < currFloor ? EC_ELEVATOR_DOWN : EC_ELEVATOR_UP); //pick them up either going up or down                             
+            auto found = state.waitingMap.find(ev.floorSrc);
+            if (found == state.waitingMap.end() || !erase(found->second, ev.reqIndex)) { return false; }
+            if (found->second.empty()) { state.waitingMap.erase(found); }
+            state.onboard.insert(std::upper_bound(state.onboard.begin(), state.onboard.end(), info, byIndex), info);
         }
-        else if (req.GetTime() <= time && !req.IsServiced()) //person picked up but not dropped off yet
+        else //gets off at floorDest
         {
-            handleDirectionChangeHelper(req);
+            if (!erase(state.onboard, ev.reqIndex)) { return false; }
         }
-        else if (req.GetTime() <= time && !req.IsServiced() && req.GetRequestedFloor() == currFloor) //if this request is fully serviced, set as stopped to update later
+    }
+    return true;
+}
+
+ECElevatorRequestStore::ECElevatorRequestStore(const std::vector<ECElevatorSimRequest>& listRequests)
+{
+    ids.reserve(listRequests.size());
+    times.reserve(listRequests.size());
+    floorSrcs.reserve(listRequests.size());
+    floorDests.reserve(listRequests.size());
+    arriveTimes.reserve(listRequests.size());
+    boardTimes.reserve(listRequests.size());
+    for (auto& req : listRequests)
+    {
+        Add(req, GetSize());
+    }
+}
+
+int ECElevatorRequestStore::Add(const ECElevatorSimRequest& req, int id)
+{
+    auto narrow = [](int floor) { return (short)(floor >= SHRT_MIN && floor <= SHRT_MAX ? floor : -1); };
+
+    if (!freeSlots.empty()) //reuse a retired slot
+    {
+        int i = freeSlots.back();
+        freeSlots.pop_back();
+        ids[i] = id;
+        times[i] = req.GetTime();
+        floorSrcs[i] = narrow(req.GetFloorSrc());
+        floorDests[i] = narrow(req.GetFloorDest());
+        arriveTimes[i] = req.GetArriveTime();
+        boardTimes[i] = req.IsFloorRequestDone() ? req.GetTime() : -1; //already on board: count as boarded when made
+        SetFloorRequestDone(i, req.IsFloorRequestDone());
+        SetServiced(i, req.IsServiced());
+        return i;
+    }
+
+    int i = GetSize();
+    ids.push_back(id);
+    times.push_back(req.GetTime());
+    floorSrcs.push_back(narrow(req.GetFloorSrc()));
+    floorDests.push_back(narrow(req.GetFloorDest()));
+    arriveTimes.push_back(req.GetArriveTime());
+    boardTimes.push_back(req.IsFloorRequestDone() ? req.GetTime() : -1);
+    if ((i & 63) == 0) //new word of flags
+    {
+        floorReqDoneBits.push_back(0);
+        servicedBits.push_back(0);
+    }
+    SetFloorRequestDone(i, req.IsFloorRequestDone());
+    SetServiced(i, req.IsServiced());
+    return i;
+}
+
+ECElevatorSimRequest ECElevatorRequestStore::Get(int i) const
+{
+    ECElevatorSimRequest req(GetTime(i), GetFloorSrc(i), GetFloorDest(i));
+    req.SetFloorRequestDone(IsFloorRequestDone(i));
+    req.SetServiced(IsServiced(i));
+    req.SetArriveTime(GetArriveTime(i));
+    return req;
+}
+
+void ECElevatorRequestStore::Set(int i, const ECElevatorSimRequest& req)
+{
+    SetFloorRequestDone(i, req.IsFloorRequestDone());
+    SetServiced(i, req.IsServiced());
+    SetArriveTime(i, req.GetArriveTime());
+}
+
+void ECElevatorRequestStore::Save(ECSnapshotWriter& out) const
+{
+    out.PutVector(ids);
+    out.PutVector(times);
+    out.PutVector(floorSrcs);
+    out.PutVector(floorDests);
+    out.PutVector(arriveTimes);
+    out.PutVector(boardTimes);
+    out.PutVector(floorReqDoneBits);
+    out.PutVector(servicedBits);
+    out.PutVector(freeSlots);
+}
+
+void ECElevatorRequestStore::Load(ECSnapshotReader& in, int numFloors, int numIds)
+{
+    in.GetVector(ids);
+    in.GetVector(times);
+    in.GetVector(floorSrcs);
+    in.GetVector(floorDests);
+    in.GetVector(arriveTimes);
+    in.GetVector(boardTimes);
+    in.GetVector(floorReqDoneBits);
+    in.GetVector(servicedBits);
+    in.GetVector(freeSlots);
+
+    size_t size = ids.size();
+    size_t numWords = (size + 63) / 64;
+    bool valid = times.size() == size && floorSrcs.size() == size && floorDests.size() == size && arriveTimes.size() == size
+        && boardTimes.size() == size && floorReqDoneBits.size() == numWords && servicedBits.size() == numWords && freeSlots.size() <= size;
+    for (size_t f = 0; valid && f < freeSlots.size(); f++)
+    {
+        valid = freeSlots[f] >= 0 && freeSlots[f] < (int)size;
+    }
+
+    //the cars and their demand indices index per-floor arrays with these, and sources index their requests with the ids
+    //(retired slots too: they held a valid request and may be handed out again)
+    for (size_t i = 0; valid && i < size; i++)
+    {
+        valid = floorSrcs[i] >= 1 && floorSrcs[i] <= numFloors && floorDests[i] >= 1 && floorDests[i] <= numFloors && ids[i] >= 0 && ids[i] < numIds;
+    }
+    if (!valid)
+    {
+        *this = ECElevatorRequestStore();
+        in.Fail();
+    }
+}
+
+int ECElevatorRequestSource::Skip(int num)
+{
+    ECElevatorSimRequest req(0, 0, 0);
+    int skipped = 0;
+    while (skipped < num && Next(req))
+    {
+        skipped++;
+    }
+    return skipped;
+}
+
+int ECElevatorVectorSource::Skip(int num)
+{
+    size_t left = pos >= requests.size() ? 0 : requests.size() - pos; //the list may have shrunk under us
+    size_t skipped = std::min((size_t)std::max(num, 0), left);
+    pos += skipped;
+    return (int)skipped;
+}
+
+std::unique_ptr<ECElevatorRequestSource> ECElevatorVectorSource::Fork() const
+{
+    //requests from pos on haven't been handed out yet, so their status in the copy is still as given;
+    //forks share one copy until the list grows, then the next fork takes a fresh one
+    if (!frozen || frozen->size() != requests.size()) { frozen = std::make_shared<const std::vector<ECElevatorSimRequest>>(requests); }
+    return std::unique_ptr<ECElevatorRequestSource>(new ECElevatorSharedVectorSource(frozen, pos));
+}
+
+bool ECElevatorSharedVectorSource::Next(ECElevatorSimRequest& req)
+{
+    if (pos >= requests->size()) { return false; }
+    req = (*requests)[pos++];
+    return true;
+}
+
+int ECElevatorSharedVectorSource::Skip(int num)
+{
+    size_t left = pos >= requests->size() ? 0 : requests->size() - pos; //pos is given to the constructor
+    size_t skipped = std::min((size_t)std::max(num, 0), left);
+    pos += skipped;
+    return (int)skipped;
+}
+
+std::unique_ptr<ECElevatorRequestSource> ECElevatorSharedVectorSource::Fork() const
+{
+    return std::unique_ptr<ECElevatorRequestSource>(new ECElevatorSharedVectorSource(requests, pos));
+}
+
+bool ECElevatorVectorSource::Next(ECElevatorSimRequest& req)
+{
+    if (pos >= requests.size()) { return false; }
+    req = requests[pos++];
+    return true;
+}
+
+//*****************************************************************************
+// ECElevatorCar
+
+static const size_t KERNEL_SCAN_MAX = 8; //most active requests FindClosestRequestFloor scans instead of asking the index
+
+ECElevatorCar::ECElevatorCar(int numFloors) : demand(numFloors) {} //start at floor 1 and initialize as stopped initially
+
+void ECElevatorCar::AddRequest(const ECElevatorRequestStore& store, int i)
+{
+    int id = store.GetId(i);
+    history.RecordArrival(id, store.GetFloorSrc(i), store.GetFloorDest(i));
+    if (store.IsFloorRequestDone(i))
+    {
+        demand.AddCarCall(store.GetFloorDest(i), id);
+        history.RecordBoarding(id, store.GetFloorSrc(i), store.GetFloorDest(i));
+    }
+    else { demand.AddHallCall(store.GetFloorSrc(i), store.IsGoingUp(i), id); }
+    active.push_back(i); //requests come in order so active stays in request order
+    activeFloors.push_back(store.GetRequestedFloor(i));
+}
+
+template <class Policy>
+void ECElevatorCar::Tick(int tm, ECElevatorRequestStore& store, ECElevatorRequestSource& source, const Policy& policy)
+{
+    history.RecordTick(tm, currFloor, currDir); //passenger changes since the last tick are already logged
+
+    UpdateDirectionAtTime(tm, policy);
+    if (currDir != EC_ELEVATOR_STOPPED) { sweepDir = currDir; }
+
+    //use the shared strategy for this direction to update floor (nothing is allocated per tick)
+    if (currDir != EC_ELEVATOR_STOPPED)
+    {
+        UpdateElevatorMovement(ECElevatorMovement::ForDirection(currDir), tm);
+    }
+    else //whenever we stop, we must update variables and times for passangers being dropped off or picked up
+    {
+        const ECElevatorMovementStop& stop = ECElevatorMovementStop::Instance(); //final class, so the calls below are not virtual
+        if (demand.AnyAt(currFloor)) //nobody to pick up or drop off otherwise
         {
-            SetCurrDir(EC_ELEVATOR_STOPPED);
+            for (size_t a = 0; a < active.size(); a++) //loop through each request in the system and mark each as done if they are done (see Stopped class)
+            {
+                if (activeFloors[a] != currFloor) { continue; } //only ppl waiting here or going here change
+
+                int i = active[a];
+
+                int id = store.GetId(i);
+                ECElevatorSimRequest req = store.Get(i);
+                bool wasOnboard = req.IsFloorRequestDone();
+                bool wasServiced = req.IsServiced();
+                stop.ChangeDirection(req, currDir, currFloor, tm);
+                store.Set(i, req);
+                source.OnUpdate(id, req);
+
+                //move the request along in the demand index
+                if (!wasOnboard && req.IsFloorRequestDone())
+                {
+                    demand.RemoveHallCall(req.GetFloorSrc(), req.IsGoingUp(), id);
+                    demand.AddCarCall(req.GetFloorDest(), id);
+                    history.RecordBoarding(id, req.GetFloorSrc(), req.GetFloorDest());
+                    store.SetBoardTime(i, tm);
+                    activeFloors[a] = req.GetFloorDest();
+                }
+                if (!wasServiced && req.IsServiced())
+                {
+                    demand.RemoveCarCall(req.GetFloorDest(), id);
+                    serviceStats.RecordServiced(req.GetTime(), store.GetBoardTime(i), req.GetArriveTime());
+                    history.RecordAlighting(id, req.GetFloorSrc(), req.GetFloorDest());
+                }
+            }
+
+            RetireServiced(store);
         }
-        prevMove = GetCurrDir(); //keep track of prev move
     }
+
+    prevMove = GetDir();
 }
 
-void ECElevatorSim::RecordState(int time)
+//active is in request order, so every list comes out sorted by request index like the history's
+void ECElevatorCar::BuildState(const ECElevatorRequestStore& store, ECElevatorState& state) const
 {
-    ECElevatorState state;
     state.floor = currFloor;
     state.dir = currDir;
+    state.waitingMap.clear();
+    state.onboard.clear();
+    for (int i : active)
+    {
+        RequestInfoAtTime info{ store.GetId(i), store.GetFloorDest(i), store.IsGoingUp(i) };
+        if (store.IsFloorRequestDone(i)) { state.onboard.push_back(info); }
+        else { state.waitingMap[store.GetFloorSrc(i)].push_back(info); }
+    }
+}
 
-    for (int i = 0; i < (int)requests.size(); i++) {
-        auto& req = requests[i];
-        if (req.GetTime() <= time && !req.IsServiced()) {
-            int floorWaitOrDest = req.IsFloorRequestDone() ? req.GetFloorDest() : req.GetFloorSrc();
-            bool goingUp = req.IsGoingUp();
-            RequestInfoAtTime info;
-            info.reqIndex = i;
-            info.destFloor = req.GetFloorDest();
-            info.goingUp = goingUp;
-
-            if (!req.IsFloorRequestDone()) {
-                //waiting at req.GetFloorSrc()
-                state.waitingMap[floorWaitOrDest].push_back(info);
-            }
-            else {
-                //not serviced yet
-                state.onboard.push_back(info);
-            }
+void ECElevatorCar::Save(ECSnapshotWriter& out) const
+{
+    out.Put(currFloor);
+    out.Put(currDir);
+    out.Put(prevMove);
+    out.Put(sweepDir);
+    out.PutVector(active);
+    history.Save(out);
+    serviceStats.Save(out);
+}
+
+void ECElevatorCar::Load(ECSnapshotReader& in, const ECElevatorRequestStore& store)
+{
+    currFloor = in.Get<int>();
+    in.ReadBytes(&currDir, sizeof(currDir)); //raw, checked below
+    in.ReadBytes(&prevMove, sizeof(prevMove));
+    in.ReadBytes(&sweepDir, sizeof(sweepDir));
+    in.GetVector(active);
+    activeFloors.clear();
+    history.Load(in, demand.GetNumFloors());
+    serviceStats.Load(in);
+
+    bool valid = in.IsOk() && currFloor >= 1 && currFloor <= demand.GetNumFloors() && IsValidDir(currDir) && IsValidDir(prevMove) && IsValidDir(sweepDir);
+    for (size_t a = 0; valid && a < active.size(); a++)
+    {
+        valid = active[a] >= 0 && active[a] < store.GetSize() && !store.IsServiced(active[a]);
+    }
+    demand.Clear();
+    if (!valid)
+    {
+        active.clear();
+        currFloor = 1;
+        currDir = prevMove = sweepDir = EC_ELEVATOR_STOPPED;
+        in.Fail();
+        return;
+    }
+
+    //the demand index (and the floors each one needs) follows from who is waiting and who is on board
+    for (int i : active)
+    {
+        activeFloors.push_back(store.GetRequestedFloor(i));
+        if (store.IsFloorRequestDone(i)) { demand.AddCarCall(store.GetFloorDest(i), store.GetId(i)); }
+        else { demand.AddHallCall(store.GetFloorSrc(i), store.IsGoingUp(i), store.GetId(i)); }
+    }
+}
+
+//serviced passengers leave the active set and give their store slot back
+void ECElevatorCar::RetireServiced(ECElevatorRequestStore& store)
+{
+    size_t keep = 0;
+    for (size_t a = 0; a < active.size(); a++)
+    {
+        if (store.IsServiced(active[a])) { store.Retire(active[a]); }
+        else
+        {
+            active[keep] = active[a];
+            activeFloors[keep++] = activeFloors[a];
         }
     }
+    active.resize(keep);
+    activeFloors.resize(keep);
+}
+
+//a handful of requests is scanned faster as a flat array than the index's sets are walked; past about 8 the
+//index wins (see ECSimBenchmark::RunKernels). Both pick the same floor: active is in request
+//order, so the first closest entry is the earliest request, which is what the index breaks ties by
+int ECElevatorCar::FindClosestRequestFloor() const
+{
+    if (activeFloors.size() > KERNEL_SCAN_MAX) { return demand.FindClosest(currFloor); }
+    return ECFloorKernels::FindClosest(activeFloors.data(), (int)activeFloors.size(), currFloor, 1, demand.GetNumFloors());
+}
+
+//ticks before the returned time are either idle (stopped with nothing to do) or plain moves towards the next floor with demand
+template <class Policy>
+int ECElevatorCar::NextEventTime(int tm, const Policy& policy) const
+{
+    if (!demand.IsEmpty() && (currDir == EC_ELEVATOR_STOPPED || demand.AnyAt(currFloor))) { return tm; } //must stop or pick a direction now
+    if (currDir == EC_ELEVATOR_STOPPED) { return INT_MAX; } //idle until someone calls
+    if (policy.NextDirection(*this) != currDir) { return tm; } //e.g. turning around for a request just made
+
+    int ticks = policy.TicksToDecision(*this);
+    return ticks == INT_MAX ? INT_MAX : tm + ticks;
+}
+
+//the car either sits still or moves one floor per tick
+void ECElevatorCar::RecordSpan(int tmStart, int tmEnd)
+{
+    int step = currDir == EC_ELEVATOR_UP ? 1 : (currDir == EC_ELEVATOR_DOWN ? -1 : 0);
+    history.RecordSpan(tmStart, tmEnd, currFloor, currDir, step);
+    currFloor += step * (tmEnd - tmStart);
+    prevMove = GetDir();
+    if (step != 0) { sweepDir = currDir; }
+}
+
+//are there any requests in the direction you're currently going?
+bool ECElevatorCar::anyDirReqs(EC_ELEVATOR_DIR move) const
+{
+    if (move == EC_ELEVATOR_UP) { return demand.AnyAbove(currFloor); }
+    if (move == EC_ELEVATOR_DOWN) { return demand.AnyBelow(currFloor); }
+    return false;
+}
+
+//are there any requests on currFloor?
+bool ECElevatorCar::anyFloorReq(int currFloor) const
+{
+    return demand.AnyAt(currFloor);
+}
 
-    recordedStates.push_back(state);
+void ECElevatorCar::handleDirectionChangeHelper(int floorRequested)
+{
+    if (floorRequested < currFloor) { SetDir(EC_ELEVATOR_DOWN); } //go down if needed
+    else if (floorRequested > currFloor) { SetDir(EC_ELEVATOR_UP); } //go up if needed
+    else { SetDir(EC_ELEVATOR_STOPPED); } //else stop
 }
 
-void ECElevatorSim::UpdateDirectionAtTime(int tm)
+void ECElevatorCar::handleDirectionChange()
+{
+    if (!demand.IsEmpty()) //head for whoever still needs us
+    {
+        handleDirectionChangeHelper(FindClosestRequestFloor());
+    }
+    prevMove = GetDir(); //keep track of prev move
+}
+
+template <class Policy>
+void ECElevatorCar::UpdateDirectionAtTime(int tm, const Policy& policy)
 {
     // If there's a request on the current floor at the current time
-    if (anyFloorReq(tm, currFloor))
+    if (anyFloorReq(currFloor))
     {
-        SetCurrDir(EC_ELEVATOR_STOPPED);
+        SetDir(EC_ELEVATOR_STOPPED);
         return;
     }
-    if (currDir != EC_ELEVATOR_STOPPED) { return; } //if in motion, don't change direction
+    SetDir(policy.NextDirection(*this));
+}
+
+void ECElevatorCar::UpdateElevatorMovement(const ECElevatorMovement& movement, int tm)
+{
+    ECElevatorSimRequest fakeReq(0, 0, 0); //up/down only move the car, they don't look at the request
+    movement.ChangeDirection(fakeReq, currDir, currFloor, tm);
+}
+
+//*****************************************************************************
+// Direction policies
+
+//direction from floor towards target
+static EC_ELEVATOR_DIR Towards(int floor, int target)
+{
+    return target > floor ? EC_ELEVATOR_UP : (target < floor ? EC_ELEVATOR_DOWN : EC_ELEVATOR_STOPPED);
+}
+
+static EC_ELEVATOR_DIR Opposite(EC_ELEVATOR_DIR dir)
+{
+    return dir == EC_ELEVATOR_UP ? EC_ELEVATOR_DOWN : (dir == EC_ELEVATOR_DOWN ? EC_ELEVATOR_UP : EC_ELEVATOR_STOPPED);
+}
+
+//moving car that only reconsiders at floors someone needs
+static int TicksToNextDemand(const ECElevatorCar& car)
+{
+    int floorAhead = car.GetDemand().DistanceAhead(car.GetFloor(), car.GetDir()); //closest floor someone needs in the direction we are moving
+    return floorAhead > 0 ? floorAhead : INT_MAX;
+}
 
-    bool upRequests = anyDirReqs(EC_ELEVATOR_UP, tm);
-    bool downRequests = anyDirReqs(EC_ELEVATOR_DOWN, tm);
-    if (upRequests && downRequests)
+const ECElevatorDirectionPolicy& ECElevatorDirectionPolicy::ForType(EC_DIRECTION_POLICY type)
+{
+    static const ECElevatorClassicPolicy classic;
+    static const ECElevatorNearestPolicy nearest;
+    static const ECElevatorLookPolicy look;
+    static const ECElevatorScanPolicy scan;
+    if (type == EC_POLICY_NEAREST) { return nearest; }
+    if (type == EC_POLICY_LOOK) { return look; }
+    if (type == EC_POLICY_SCAN) { return scan; }
+    return classic;
+}
+
+bool ECElevatorDirectionPolicy::Parse(const std::string& name, EC_DIRECTION_POLICY& type)
+{
+    for (EC_DIRECTION_POLICY t : { EC_POLICY_CLASSIC, EC_POLICY_NEAREST, EC_POLICY_LOOK, EC_POLICY_SCAN })
     {
-        int nearestFloor = findClosestRequestFloor(currFloor, tm);
-        if (nearestFloor > currFloor)
+        if (name == GetName(t))
         {
-            SetCurrDir(EC_ELEVATOR_UP);
+            type = t;
+            return true;
         }
-        else if (nearestFloor < currFloor)
+    }
+    return false;
+}
+
+const char* ECElevatorDirectionPolicy::GetName(EC_DIRECTION_POLICY type)
+{
+    if (type == EC_POLICY_CLASSIC) { return "classic"; }
+    if (type == EC_POLICY_NEAREST) { return "nearest"; }
+    if (type == EC_POLICY_LOOK) { return "look"; }
+    if (type == EC_POLICY_SCAN) { return "scan"; }
+    return "custom";
+}
+
+//once moving, keep going (the car stops at the next floor someone needs); from a stop, go where the
+//requests are, towards the closest floor with demand if there are some both ways
+EC_ELEVATOR_DIR ECElevatorClassicPolicy::NextDirection(const ECElevatorCar& car) const
+{
+    if (car.GetDir() != EC_ELEVATOR_STOPPED) { return car.GetDir(); } //if in motion, don't change direction
+
+    bool upRequests = car.anyDirReqs(EC_ELEVATOR_UP);
+    bool downRequests = car.anyDirReqs(EC_ELEVATOR_DOWN);
+    if (upRequests && downRequests) { return Towards(car.GetFloor(), car.FindClosestRequestFloor()); }
+    if (upRequests) { return EC_ELEVATOR_UP; }
+    if (downRequests) { return EC_ELEVATOR_DOWN; }
+    return EC_ELEVATOR_STOPPED;
+}
+
+int ECElevatorClassicPolicy::TicksToDecision(const ECElevatorCar& car) const { return TicksToNextDemand(car); }
+
+//closest floor with demand, reconsidered every tick
+EC_ELEVATOR_DIR ECElevatorNearestPolicy::NextDirection(const ECElevatorCar& car) const
+{
+    if (car.GetDemand().IsEmpty()) { return EC_ELEVATOR_STOPPED; }
+    return Towards(car.GetFloor(), car.FindClosestRequestFloor());
+}
+
+//heading for the closest floor only brings it closer and the others (behind) further away, so
+//nothing changes until we get there or a request is made
+int ECElevatorNearestPolicy::TicksToDecision(const ECElevatorCar& car) const { return TicksToNextDemand(car); }
+
+EC_ELEVATOR_DIR ECElevatorLookPolicy::NextDirection(const ECElevatorCar& car) const
+{
+    if (car.GetDemand().IsEmpty()) { return EC_ELEVATOR_STOPPED; }
+
+    EC_ELEVATOR_DIR dir = car.GetDir() != EC_ELEVATOR_STOPPED ? car.GetDir() : car.GetSweepDir();
+    if (dir == EC_ELEVATOR_STOPPED) { return Towards(car.GetFloor(), car.FindClosestRequestFloor()); } //first call ever
+    if (car.anyDirReqs(dir)) { return dir; }
+    return car.anyDirReqs(Opposite(dir)) ? Opposite(dir) : EC_ELEVATOR_STOPPED;
+}
+
+int ECElevatorLookPolicy::TicksToDecision(const ECElevatorCar& car) const { return TicksToNextDemand(car); }
+
+EC_ELEVATOR_DIR ECElevatorScanPolicy::NextDirection(const ECElevatorCar& car) const
+{
+    if (car.GetDemand().IsEmpty()) { return EC_ELEVATOR_STOPPED; }
+
+    EC_ELEVATOR_DIR dir = car.GetDir() != EC_ELEVATOR_STOPPED ? car.GetDir() : car.GetSweepDir();
+    if (dir == EC_ELEVATOR_STOPPED) { return Towards(car.GetFloor(), car.FindClosestRequestFloor()); } //first call ever
+    if (dir == EC_ELEVATOR_UP && car.GetFloor() >= car.GetDemand().GetNumFloors()) { return EC_ELEVATOR_DOWN; } //end of the shaft
+    if (dir == EC_ELEVATOR_DOWN && car.GetFloor() <= 1) { return EC_ELEVATOR_UP; }
+    return dir;
+}
+
+//next floor someone needs, or the end of the shaft (where it turns around)
+int ECElevatorScanPolicy::TicksToDecision(const ECElevatorCar& car) const
+{
+    int toEnd = car.GetDir() == EC_ELEVATOR_UP ? car.GetDemand().GetNumFloors() - car.GetFloor() : car.GetFloor() - 1;
+    return std::min(TicksToNextDemand(car), toEnd);
+}
+
+//*****************************************************************************
+// ECElevatorNearestCarDispatcher
+
+int ECElevatorNearestCarDispatcher::TravelDistance(const ECElevatorCar& car, int floorSrc, bool goingUp)
+{
+    int floor = car.GetFloor();
+    const ECElevatorDemandIndex& demand = car.GetDemand();
+    if (car.GetDir() == EC_ELEVATOR_STOPPED || demand.IsEmpty()) { return std::abs(floorSrc - floor); }
+
+    if (car.GetDir() == EC_ELEVATOR_UP)
+    {
+        if (goingUp && floorSrc >= floor) { return floorSrc - floor; } //on the way
+        int top = std::max(floor, demand.GetHighest());
+        return (top - floor) + std::abs(top - floorSrc);
+    }
+    if (!goingUp && floorSrc <= floor) { return floor - floorSrc; } //on the way
+    int bottom = std::min(floor, demand.GetLowest());
+    return (floor - bottom) + std::abs(floorSrc - bottom);
+}
+
+int ECElevatorNearestCarDispatcher::AssignCar(const std::vector<ECElevatorCar>& cars, int floorSrc, bool goingUp)
+{
+    int best = 0;
+    int bestDist = INT_MAX;
+    for (int c = 0; c < (int)cars.size(); c++)
+    {
+        int dist = TravelDistance(cars[c], floorSrc, goingUp);
+        if (dist < bestDist)
         {
-            SetCurrDir(EC_ELEVATOR_DOWN);
+            best = c;
+            bestDist = dist;
         }
-        else
+    }
+    return best;
+}
+
+//*****************************************************************************
+// ECElevatorSim
+
+ECElevatorSim::ECElevatorSim(int numFloors, std::vector<ECElevatorSimRequest>& listRequests) : numFloors(numFloors)
+{
+    //the arrival cursor needs requests in time order (main.cpp already sorts, so this is normally a no-op)
+    auto byTime = [](const ECElevatorSimRequest& a, const ECElevatorSimRequest& b) { return a.GetTime() < b.GetTime(); };
+    if (!std::is_sorted(listRequests.begin(), listRequests.end(), byTime))
+    {
+        std::stable_sort(listRequests.begin(), listRequests.end(), byTime);
+    }
+    ownedSource.reset(new ECElevatorVectorSource(listRequests));
+    source = ownedSource.get();
+    Init(1, nullptr);
+}
+
+ECElevatorSim::ECElevatorSim(int numFloors, ECElevatorRequestSource& source) : ECElevatorSim(numFloors, 1, source) {}
+
+ECElevatorSim::ECElevatorSim(int numFloors, int numCars, ECElevatorRequestSource& source, ECElevatorDispatcher* dispatcher) : source(&source), numFloors(numFloors)
+{
+    Init(numCars, dispatcher);
+}
+
+ECElevatorSim::ECElevatorSim(const ECElevatorSim& parent, std::unique_ptr<ECElevatorRequestSource> sourceIn) :
+    ownedSource(std::move(sourceIn)), source(ownedSource.get()), store(parent.store), numFloors(parent.numFloors), cars(parent.cars),
+    dispatcher(parent.dispatcher), dirPolicy(parent.dirPolicy), tmNow(parent.tmNow), nextReq(parent.nextReq), hasNextReq(parent.hasNextReq), nextReqIndex(parent.nextReqIndex)
+{
+    if (parent.ownedDispatcher) //the default one has no state, so a fork just gets its own
+    {
+        ownedDispatcher.reset(new ECElevatorNearestCarDispatcher());
+        dispatcher = ownedDispatcher.get();
+    }
+}
+
+std::unique_ptr<ECElevatorSim> ECElevatorSim::Fork() const
+{
+    std::unique_ptr<ECElevatorRequestSource> sourceFork = source->Fork();
+    if (!sourceFork) { return nullptr; }
+    return std::unique_ptr<ECElevatorSim>(new ECElevatorSim(*this, std::move(sourceFork)));
+}
+
+void ECElevatorSim::Init(int numCars, ECElevatorDispatcher* dispatcherIn)
+{
+    cars.assign(std::max(numCars, 1), ECElevatorCar(numFloors));
+    if (dispatcherIn == nullptr)
+    {
+        ownedDispatcher.reset(new ECElevatorNearestCarDispatcher());
+        dispatcherIn = ownedDispatcher.get();
+    }
+    dispatcher = dispatcherIn;
+    dirPolicy = &ECElevatorDirectionPolicy::ForType(EC_POLICY_CLASSIC);
+    FetchNextRequest();
+}
+
+void ECElevatorSim::Simulate(int lenSim)
+{
+    WithPolicy([&](const auto& policy) { Simulate(lenSim, policy); });
+}
+
+void ECElevatorSim::SimulateEventDriven(int lenSim)
+{
+    WithPolicy([&](const auto& policy) { SimulateEventDriven(lenSim, policy); });
+}
+
+//the virtual call to find out the policy's type happens once here, not per tick
+template <class Fn>
+void ECElevatorSim::WithPolicy(Fn fn) const
+{
+    switch (dirPolicy->GetType())
+    {
+    case EC_POLICY_CLASSIC: fn(static_cast<const ECElevatorClassicPolicy&>(*dirPolicy)); break;
+    case EC_POLICY_NEAREST: fn(static_cast<const ECElevatorNearestPolicy&>(*dirPolicy)); break;
+    case EC_POLICY_LOOK: fn(static_cast<const ECElevatorLookPolicy&>(*dirPolicy)); break;
+    case EC_POLICY_SCAN: fn(static_cast<const ECElevatorScanPolicy&>(*dirPolicy)); break;
+    default: fn(*dirPolicy); break;
+    }
+}
+
+template <class Policy>
+void ECElevatorSim::Simulate(int lenSim, const Policy& policy)
+{
+    PollSource();
+    for (; tmNow < lenSim; tmNow++) //simulate time
+    {
+        SimulateTick(tmNow, policy);
+    }
+}
+
+template <class Policy>
+void ECElevatorSim::SimulateEventDriven(int lenSim, const Policy& policy)
+{
+    PollSource();
+    int tm = tmNow;
+    while (tm < lenSim)
+    {
+        ActivateRequests(tm);
+        int tmNext = std::min(NextEventTime(tm, policy), lenSim);
+        if (tmNext > tm) //nothing interesting until tmNext, so record the whole span at once
         {
-            SetCurrDir(EC_ELEVATOR_STOPPED);
+            RecordSpan(tm, tmNext);
+            tm = tmNext;
+        }
+        else //something happens at this tick so run the full logic
+        {
+            SimulateTick(tm, policy);
+            tm++;
         }
     }
-    else if (upRequests)
+    tmNow = std::max(tmNow, lenSim);
+}
+
+template <class Policy>
+void ECElevatorSim::SimulateTick(int tm, const Policy& policy)
+{
+    ActivateRequests(tm);
+
+    for (ECElevatorCar& car : cars)
     {
-        // Continue moving in the previous direction if requests exist that way
-        SetCurrDir(EC_ELEVATOR_UP);
+        car.Tick(tm, store, *source, policy);
     }
-    else if (downRequests)
+}
+
+//first time >= tm at which the full tick logic must run: a request is made or some car needs it
+template <class Policy>
+int ECElevatorSim::NextEventTime(int tm, const Policy& policy) const
+{
+    int tmNext = NextArrivalTime();
+    for (const ECElevatorCar& car : cars)
     {
-        SetCurrDir(EC_ELEVATOR_DOWN);
+        tmNext = std::min(tmNext, car.NextEventTime(tm, policy));
     }
-    else
+    return tmNext;
+}
+
+void ECElevatorSim::RecordSpan(int tmStart, int tmEnd)
+{
+    for (ECElevatorCar& car : cars)
     {
-        // Need to handle changing direction based on available requests
-        handleDirectionChange(tm);
+        car.RecordSpan(tmStart, tmEnd);
     }
 }
 
-void ECElevatorSim::UpdateElevatorMovement(ECElevatorMovement* movement, int tm)
+void ECElevatorSim::SetRecordHistory(bool f)
 {
-    ECElevatorSimRequest fakeReq(0, 0, 0);
-    if (tm < (int)requests.size())
+    for (ECElevatorCar& car : cars)
     {
-        movement->ChangeDirection(requests[tm], currDir, currFloor, tm);
+        car.SetRecordHistory(f);
     }
-    else
+}
+
+//move the arrival cursor past requests made up to tm, adding them to the store and handing each to a car
+void ECElevatorSim::ActivateRequests(int tm)
+{
+    for (; hasNextReq && nextReq.GetTime() <= tm; FetchNextRequest())
     {
-        movement->ChangeDirection(fakeReq, currDir, currFloor, tm);
+        if (!IsValidRequest(nextReq) || nextReq.IsServiced()) { continue; }
+
+        int i = store.Add(nextReq, nextReqIndex);
+        int c = cars.size() == 1 ? 0 : dispatcher->AssignCar(cars, nextReq.GetFloorSrc(), nextReq.IsGoingUp());
+        cars[c].AddRequest(store, i);
     }
 }
 
-int ECElevatorSim::findClosestRequestFloor(int currFloor, int time) const
+void ECElevatorSim::FetchNextRequest()
 {
-    int bestFloor = currFloor;
-    int bestDist = 999999;
+    hasNextReq = source->Next(nextReq);
+    nextReqIndex++;
+}
+
+//the source had no more requests last time; it may have been given some since (the cursor already points past the last one)
+void ECElevatorSim::PollSource()
+{
+    if (!hasNextReq) { hasNextReq = source->Next(nextReq); }
+}
 
-    for (auto& req : requests)
+//requests outside floors 1..numFloors (e.g. the maintenance markers) are not serviced; floors must also fit the store's 16-bit columns
+bool ECElevatorSim::IsValidRequest(const ECElevatorSimRequest& req) const
+{
+    int floorMax = std::min(numFloors, (int)SHRT_MAX);
+    return req.GetFloorSrc() >= 1 && req.GetFloorSrc() <= floorMax && req.GetFloorDest() >= 1 && req.GetFloorDest() <= floorMax;
+}
+
+//time of the next request not made yet (INT_MAX if none)
+int ECElevatorSim::NextArrivalTime() const
+{
+    return hasNextReq ? nextReq.GetTime() : INT_MAX;
+}
+
+//*****************************************************************************
+// Checkpoints
+// Header: magic, version, floors, cars, direction policy, clock and the arrival cursor;
+// then the request store and each car (position, active set, history, statistics)
+
+static const char CheckpointMagic[4] = { 'E', 'C', 'S', 'S' };
+static const uint32_t CheckpointVersion = 1;
+
+bool ECElevatorSim::SaveCheckpoint(std::ostream& outStream) const
+{
+    ECSnapshotWriter out(outStream);
+    out.WriteBytes(CheckpointMagic, sizeof(CheckpointMagic));
+    out.Put(CheckpointVersion);
+    out.Put((int32_t)numFloors);
+    out.Put((int32_t)cars.size());
+    out.Put((int32_t)dirPolicy->GetType());
+    out.Put((int32_t)tmNow);
+
+    out.Put((int32_t)nextReqIndex);
+    out.Put((uint8_t)hasNextReq);
+    out.Put((int32_t)nextReq.GetTime());
+    out.Put((int32_t)nextReq.GetFloorSrc());
+    out.Put((int32_t)nextReq.GetFloorDest());
+    out.Put((uint8_t)nextReq.IsFloorRequestDone());
+    out.Put((uint8_t)nextReq.IsServiced());
+    out.Put((int32_t)nextReq.GetArriveTime());
+
+    store.Save(out);
+    for (const ECElevatorCar& car : cars)
     {
-        if (!req.IsServiced() && req.GetTime() <= time)
-        {
-            int floorNeeded = req.GetRequestedFloor();
-            if (floorNeeded >= 1 && floorNeeded <= numFloors && floorNeeded != -1)
-            {
-                int dist = std::abs(floorNeeded - currFloor);
-                if (dist < bestDist)
-                {
-                    bestDist = dist;
-                    bestFloor = floorNeeded;
-                }
-            }
-        }
+        car.Save(out);
+    }
+    return out.IsOk();
+}
+
+bool ECElevatorSim::RestoreCheckpoint(std::istream& inStream, std::string& error)
+{
+    ECSnapshotReader in(inStream);
+    char magic[sizeof(CheckpointMagic)];
+    if (!in.ReadBytes(magic, sizeof(magic)) || memcmp(magic, CheckpointMagic, sizeof(magic)) != 0)
+    {
+        error = "not a simulator checkpoint";
+        return false;
+    }
+    uint32_t version = in.Get<uint32_t>();
+    int floorsIn = in.Get<int32_t>();
+    int carsIn = in.Get<int32_t>();
+    int policyIn = in.Get<int32_t>();
+    int tmIn = in.Get<int32_t>();
+    int reqIndexIn = in.Get<int32_t>();
+    bool hasReqIn = in.Get<uint8_t>() != 0;
+    int reqTime = in.Get<int32_t>();
+    int reqSrc = in.Get<int32_t>();
+    int reqDest = in.Get<int32_t>();
+    ECElevatorSimRequest reqIn(reqTime, reqSrc, reqDest);
+    reqIn.SetFloorRequestDone(in.Get<uint8_t>() != 0);
+    reqIn.SetServiced(in.Get<uint8_t>() != 0);
+    reqIn.SetArriveTime(in.Get<int32_t>());
+    if (!in.IsOk())
+    {
+        error = "checkpoint is truncated";
+        return false;
+    }
+    if (version != CheckpointVersion)
+    {
+        error = "unsupported checkpoint version " + std::to_string(version);
+        return false;
+    }
+    if (floorsIn != numFloors || carsIn != (int)cars.size())
+    {
+        error = "checkpoint is for " + std::to_string(floorsIn) + " floors and " + std::to_string(carsIn) + " cars";
+        return false;
     }
-    return bestFloor;
-}
\ No newline at end of file
+    if (reqIndexIn < nextReqIndex || tmIn < 0)
+    {
+        error = "the simulator has already read past the checkpoint (restore into a new one)";
+        return false;
+    }
+
+    //the source has handed out requests 0..nextReqIndex; the snapshot's cursor holds request reqIndexIn.
+    //A source that runs out before that isn't the one the checkpoint was taken on
+    int skipped = source->Skip(reqIndexIn - nextReqIndex);
+    if ((long long)nextReqIndex + hasNextReq + skipped < (long long)reqIndexIn + hasReqIn)
+    {
+        error = "checkpoint is for a longer trace";
+        return false;
+    }
+    nextReq = reqIn;
+    hasNextReq = hasReqIn;
+    nextReqIndex = reqIndexIn;
+    tmNow = tmIn;
+    if (policyIn >= EC_POLICY_CLASSIC && policyIn < EC_POLICY_CUSTOM) { SetDirectionPolicy((EC_DIRECTION_POLICY)policyIn); }
+
+    store.Load(in, numFloors, reqIndexIn);
+    for (ECElevatorCar& car : cars)
+    {
+        car.Load(in, store);
+    }
+    if (!in.IsOk())
+    {
+        error = "checkpoint is corrupt";
+        return false;
+    }
+    return true;
+}
+
+ECElevatorServiceStats ECElevatorSim::GetServiceStats() const
+{
+    ECElevatorServiceStats stats;
+    for (const ECElevatorCar& car : cars)
+    {
+        stats.Merge(car.GetServiceStats());
+    }
+    return stats;
+}
+
+void ECElevatorSim::BuildCurrState(ECElevatorState& state, int c)
+{
+    PollSource();
+    ActivateRequests(tmNow);
+    cars[c].BuildState(store, state);
+}
+
+std::vector<ECElevatorState> ECElevatorSim::GetAllStates() const
+{
+    const ECElevatorHistory& history = GetHistory();
+    std::vector<ECElevatorState> states;
+    states.reserve(history.GetNumTicks());
+    for (int tm = 0; tm < history.GetNumTicks(); tm++)
+    {
+        states.push_back(history.GetState(tm));
+    }
+    return states;
+}
+
+//policies the templated loop is built for (see ECElevatorSim.h)
+template void ECElevatorSim::Simulate(int, const ECElevatorClassicPolicy&);
+template void ECElevatorSim::Simulate(int, const ECElevatorNearestPolicy&);
+template void ECElevatorSim::Simulate(int, const ECElevatorLookPolicy&);
+template void ECElevatorSim::Simulate(int, const ECElevatorScanPolicy&);
+template void ECElevatorSim::Simulate(int, const ECElevatorDirectionPolicy&);
+template void ECElevatorSim::SimulateEventDriven(int, const ECElevatorClassicPolicy&);
+template void ECElevatorSim::SimulateEventDriven(int, const ECElevatorNearestPolicy&);
+template void ECElevatorSim::SimulateEventDriven(int, const ECElevatorLookPolicy&);
+template void ECElevatorSim::SimulateEventDriven(int, const ECElevatorScanPolicy&);
+template void ECElevatorSim::SimulateEventDriven(int, const ECElevatorDirectionPolicy&);
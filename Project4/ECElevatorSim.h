@@ -5,16 +5,16 @@
 #ifndef ECElevatorSim_h
 #define ECElevatorSim_h
 
-#include "ECObserver.h"
-#include "ECGraphicViewImp.h"
-#include "ECElevatorSim.h"
-
-
 #include <iostream>
 #include <set>
 #include <vector>
 #include <map>
 #include <string>
+#include <climits>
+#include <memory>
+#include "ECElevatorStats.h"
+#include "ECSimSnapshot.h"
+#include "ECSharedLog.h"
 
 //*****************************************************************************
 // DON'T CHANGE THIS CLASS
@@ -109,45 +109,448 @@ struct RequestInfoAtTime
 
 struct ECElevatorState
 {
-    int floor;
-    EC_ELEVATOR_DIR dir;
+    int floor = 1;
+    EC_ELEVATOR_DIR dir = EC_ELEVATOR_STOPPED;
     std::map<int, std::vector<RequestInfoAtTime>> waitingMap; //map since floor and num ppl
     std::vector<RequestInfoAtTime> onboard; //plain vector for ppl in cabin
 };
 
+//*****************************************************************************
+// Recorded history of the simulation, one state per tick
+// Instead of a full ECElevatorState per tick, we store:
+// (i) runs of ticks in which nothing but the floor changes (car idle or moving one floor per tick)
+// (ii) a log of passenger events (arrived, boarded, alighted) applied between runs
+// (iii) a full state (keyframe) every so many events
+// Any tick's state is rebuilt from the closest keyframe before it; stepping forward tick by tick
+// (as playback does) only replays the events in between
+// The three logs are kept in shared chunks, so copying a history (forking a simulator) is cheap
+
+class ECElevatorHistory
+{
+public:
+    ECElevatorHistory(int keyframeEvents = 1024);
+
+    //recording: passenger events are attached to the next recorded tick
+    void RecordArrival(int reqIndex, int floorSrc, int floorDest);
+    void RecordBoarding(int reqIndex, int floorSrc, int floorDest);
+    void RecordAlighting(int reqIndex, int floorSrc, int floorDest);
+    void RecordTick(int tm, int floor, EC_ELEVATOR_DIR dir) { RecordSpan(tm, tm + 1, floor, dir, 0); }
+    void RecordSpan(int tmStart, int tmEnd, int floorStart, EC_ELEVATOR_DIR dir, int step); //ticks [tmStart, tmEnd), floor changes by step per tick
+    void SetRecording(bool f) { recording = f; } //when off, only the tick count is kept (for long runs nobody plays back)
+    bool IsRecording() const { return recording; }
+
+    //random access
+    int GetNumTicks() const { return numTicks; }
+    int GetFloor(int tm) const;
+    EC_ELEVATOR_DIR GetDir(int tm) const { return runs[FindRun(tm)].dir; }
+    const ECElevatorState& GetState(int tm) const; //reference stays valid until the next GetState call
+
+    //checkpoints: runs, events and where the keyframes were taken (their states are rebuilt on load)
+    void Save(ECSnapshotWriter& out) const;
+    void Load(ECSnapshotReader& in, int numFloors); //fails the reader if the logs don't describe a possible run in a building that tall
+
+private:
+    enum EventType { EV_ARRIVE, EV_BOARD, EV_ALIGHT };
+    struct Event
+    {
+        int reqIndex;
+        short floorSrc;
+        short floorDest;
+        unsigned char type;
+    };
+    struct Run
+    {
+        int tmStart;
+        int floorStart;
+        int step; //floor change per tick
+        EC_ELEVATOR_DIR dir;
+        int eventEnd; //events [0, eventEnd) have happened by the start of this run
+    };
+    struct Keyframe
+    {
+        int eventEnd; //state after events [0, eventEnd)
+        ECElevatorState state;
+    };
+
+    void AddEvent(EventType type, int reqIndex, int floorSrc, int floorDest);
+    int FindRun(int tm) const;
+    bool ApplyEvents(ECElevatorState& state, int eventBegin, int eventEnd) const;
+
+    int keyframeEvents; //events between keyframes
+    bool recording = true;
+    int numTicks = 0;
+    ECSharedLog<Run, 10> runs; //copies (forks) share what was recorded before they were made
+    ECSharedLog<Event, 10> events;
+    ECSharedLog<Keyframe, 4> keyframes;
+
+    //last rebuilt state, so playing forward tick by tick is cheap
+    mutable ECElevatorState cachedState;
+    mutable int cachedEventEnd = -1;
+};
+
+// Movement strategies hold no state, so there is exactly one shared instance per direction
+// (use ForDirection/Instance); the simulation loop never allocates them
+
 class ECElevatorMovement
 {
 public:
     ECElevatorMovement(EC_ELEVATOR_DIR direc); //default constructoir
-    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) = 0; //virtual method
+    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const = 0; //virtual method
     virtual ~ECElevatorMovement() {} //destreuctor
+    EC_ELEVATOR_DIR GetDirection() const { return direction; }
+
+    static const ECElevatorMovement& ForDirection(EC_ELEVATOR_DIR direc); //shared strategy for a direction
 private:
     EC_ELEVATOR_DIR direction; //to save direc
 };
 
-class ECElevatorMovementUp : public ECElevatorMovement //UP movement class inherits
+class ECElevatorMovementUp final : public ECElevatorMovement //UP movement class inherits
 {
 public:
     ECElevatorMovementUp();
-    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime);
+    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const override;
+    static const ECElevatorMovementUp& Instance();
 };
 
-class ECElevatorMovementDown : public ECElevatorMovement //DOWN movement class inherits
+class ECElevatorMovementDown final : public ECElevatorMovement //DOWN movement class inherits
 {
 public:
     ECElevatorMovementDown();
-    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime);
+    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const override;
+    static const ECElevatorMovementDown& Instance();
 };
 
-class ECElevatorMovementStop : public ECElevatorMovement //STOP movement class inherits
+class ECElevatorMovementStop final : public ECElevatorMovement //STOP movement class inherits
 {
 public:
     ECElevatorMovementStop();
-    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime);
+    virtual void ChangeDirection(ECElevatorSimRequest& req, EC_ELEVATOR_DIR direc, int& floor, int const currTime) const override;
+    static const ECElevatorMovementStop& Instance();
+};
+
+//*****************************************************************************
+// Columnar store of requests
+// Same data as a list of ECElevatorSimRequest, but each field lives in its own contiguous array:
+// times, source/destination floors as 16-bit ints, board and arrive times, and the two status flags packed
+// as bits. Scans only touch the columns they need and each request takes ~12 bytes instead of 20
+// Floors that don't fit in 16 bits are stored as -1 (not a valid floor)
+// Get/Set convert to and from ECElevatorSimRequest so code written against that API still works
+// Each slot also keeps the request's index in the trace (its id). Retired slots are reused by the
+// next Add, so a store fed from a stream only grows to the peak number of requests in flight
+
+class ECElevatorRequestStore
+{
+public:
+    ECElevatorRequestStore() {}
+    ECElevatorRequestStore(const std::vector<ECElevatorSimRequest>& listRequests);
+
+    int Add(const ECElevatorSimRequest& req, int id); //returns the slot used
+    void Retire(int i) { freeSlots.push_back(i); } //slot i can be reused
+    int GetSize() const { return (int)times.size(); } //slots, including retired ones
+    int GetNumInUse() const { return GetSize() - (int)freeSlots.size(); }
+
+    int GetId(int i) const { return ids[i]; }
+
+    int GetTime(int i) const { return times[i]; }
+    int GetFloorSrc(int i) const { return floorSrcs[i]; }
+    int GetFloorDest(int i) const { return floorDests[i]; }
+    bool IsGoingUp(int i) const { return floorDests[i] >= floorSrcs[i]; }
+
+    bool IsFloorRequestDone(int i) const { return GetBit(floorReqDoneBits, i); }
+    void SetFloorRequestDone(int i, bool f) { SetBit(floorReqDoneBits, i, f); }
+    bool IsServiced(int i) const { return GetBit(servicedBits, i); }
+    void SetServiced(int i, bool f) { SetBit(servicedBits, i, f); }
+    int GetRequestedFloor(int i) const { return IsServiced(i) ? -1 : (IsFloorRequestDone(i) ? GetFloorDest(i) : GetFloorSrc(i)); }
+
+    int GetArriveTime(int i) const { return arriveTimes[i]; }
+    void SetArriveTime(int i, int t) { arriveTimes[i] = t; }
+
+    //when the user got on (-1 while waiting); not part of ECElevatorSimRequest, so Get/Set leave it alone
+    int GetBoardTime(int i) const { return boardTimes[i]; }
+    void SetBoardTime(int i, int t) { boardTimes[i] = t; }
+
+    //adapter to/from the request class
+    ECElevatorSimRequest Get(int i) const; //copy of request i, status included
+    void Set(int i, const ECElevatorSimRequest& req); //take over the status (flags and arrive time) of req
+
+    //checkpoints: every column as is; Load fails the reader unless every floor is in 1..numFloors and every id below numIds
+    void Save(ECSnapshotWriter& out) const;
+    void Load(ECSnapshotReader& in, int numFloors, int numIds);
+
+private:
+    static bool GetBit(const std::vector<unsigned long long>& bits, int i) { return (bits[i >> 6] >> (i & 63)) & 1ULL; }
+    static void SetBit(std::vector<unsigned long long>& bits, int i, bool f)
+    {
+        if (f) { bits[i >> 6] |= 1ULL << (i & 63); }
+        else { bits[i >> 6] &= ~(1ULL << (i & 63)); }
+    }
+
+    std::vector<int> ids; //index of each request in the trace
+    std::vector<int> times; //when each request is made
+    std::vector<short> floorSrcs; //where each user waits
+    std::vector<short> floorDests; //where each user goes
+    std::vector<int> arriveTimes; //when each user reached the destination (-1 until then)
+    std::vector<int> boardTimes; //when each user boarded (-1 until then)
+    std::vector<unsigned long long> floorReqDoneBits; //boarded flags, 64 per word
+    std::vector<unsigned long long> servicedBits; //serviced flags, 64 per word
+    std::vector<int> freeSlots; //retired slots
+};
+
+//*****************************************************************************
+// Where the simulator gets its requests from
+// Next hands out requests in time order, one at a time, only when the simulation reaches them;
+// the simulator numbers them 0, 1, 2, ... in the order they come (the request's index) and reports
+// every status change (boarded, serviced) through OnUpdate. Once a request is serviced the simulator
+// drops it, so a source that doesn't keep requests itself lets arbitrarily long traces run in
+// memory bounded by the passengers in flight
+
+class ECElevatorRequestSource
+{
+public:
+    virtual ~ECElevatorRequestSource() {}
+    virtual bool Next(ECElevatorSimRequest& req) = 0; //next request in time order; false when there are no more
+    virtual void OnUpdate(int reqIndex, const ECElevatorSimRequest& req) {} //status of request reqIndex changed
+    virtual int Skip(int num); //drop the next num requests (restoring a checkpoint); returns how many there were
+
+    // Independent cursor at the same position over the same requests, for a forked simulator;
+    // nullptr if this source can't do that
+    virtual std::unique_ptr<ECElevatorRequestSource> Fork() const { return nullptr; }
+};
+
+// Requests already in memory; writes status changes back into the list
+class ECElevatorVectorSource : public ECElevatorRequestSource
+{
+public:
+    ECElevatorVectorSource(std::vector<ECElevatorSimRequest>& listRequests) : requests(listRequests) {}
+    virtual bool Next(ECElevatorSimRequest& req) override;
+    virtual void OnUpdate(int reqIndex, const ECElevatorSimRequest& req) override { requests[reqIndex] = req; }
+    virtual int Skip(int num) override;
+    virtual std::unique_ptr<ECElevatorRequestSource> Fork() const override; //forks read a copy of the list, taken again whenever its size has changed
+
+private:
+    std::vector<ECElevatorSimRequest>& requests;
+    size_t pos = 0;
+    mutable std::shared_ptr<const std::vector<ECElevatorSimRequest>> frozen; //shared by the forks taken since the list last changed size
+};
+
+// Requests shared read-only between forked simulators; status changes are not written anywhere
+class ECElevatorSharedVectorSource : public ECElevatorRequestSource
+{
+public:
+    ECElevatorSharedVectorSource(std::shared_ptr<const std::vector<ECElevatorSimRequest>> listRequests, size_t pos = 0) : requests(listRequests), pos(pos) {}
+    virtual bool Next(ECElevatorSimRequest& req) override;
+    virtual int Skip(int num) override;
+    virtual std::unique_ptr<ECElevatorRequestSource> Fork() const override;
+
+private:
+    std::shared_ptr<const std::vector<ECElevatorSimRequest>> requests;
+    size_t pos;
+};
+
+//*****************************************************************************
+// Live index of pending demand, per floor
+// Hall calls: passengers waiting at a floor (split by the direction they want to go)
+// Car calls: passengers on board, keyed by their destination floor
+// The simulator adds a hall call when a request is made, turns it into a car call on boarding
+// and removes the car call once serviced, so direction and nearest-floor queries never need to
+// walk the full request list
+
+class ECElevatorDemandIndex
+{
+public:
+    ECElevatorDemandIndex(int numFloors);
+
+    void Clear();
+
+    //keep the index in sync with request status
+    void AddHallCall(int floor, bool goingUp, int reqIndex);
+    void RemoveHallCall(int floor, bool goingUp, int reqIndex);
+    void AddCarCall(int floor, int reqIndex);
+    void RemoveCarCall(int floor, int reqIndex);
+
+    //counts per floor
+    int GetNumHallCalls(int floor, bool goingUp) const { return goingUp ? hallUp[floor] : hallDown[floor]; }
+    int GetNumCarCalls(int floor) const { return carCalls[floor]; }
+
+    //queries
+    bool IsEmpty() const { return floorsWithDemand.empty(); }
+    bool AnyAt(int floor) const { return floor >= 1 && floor < (int)reqsAtFloor.size() && !reqsAtFloor[floor].empty(); }
+    bool AnyAbove(int floor) const { return !IsEmpty() && *floorsWithDemand.rbegin() > floor; }
+    bool AnyBelow(int floor) const { return !IsEmpty() && *floorsWithDemand.begin() < floor; }
+    int GetNumFloors() const { return (int)hallUp.size() - 1; }
+    int GetLowest() const { return *floorsWithDemand.begin(); } //lowest/highest floor with demand (only if not empty)
+    int GetHighest() const { return *floorsWithDemand.rbegin(); }
+    int DistanceAhead(int floor, EC_ELEVATOR_DIR dir) const; //distance to the closest floor with demand in direction dir (0 if none)
+    int FindClosest(int floor) const; //closest floor with demand, ties go to the earliest request (floor itself if none)
+
+private:
+    void AddRequest(int floor, int reqIndex);
+    void RemoveRequest(int floor, int reqIndex);
+
+    std::vector<int> hallUp; //num of ppl waiting to go up, per floor
+    std::vector<int> hallDown; //num of ppl waiting to go down, per floor
+    std::vector<int> carCalls; //num of ppl on board going to each floor
+    std::vector<std::set<int>> reqsAtFloor; //indices of requests that need each floor (waiting there or going there)
+    std::set<int> floorsWithDemand; //floors with at least one request, sorted
+};
+
+//*****************************************************************************
+// One elevator car
+// Floor, direction, the demand index of the requests it serves, its active set and its recorded
+// history. The request data itself lives in the simulator's shared store; a car only holds slots
+// into it, so its per-tick work depends on its own passengers only
+
+class ECElevatorCar
+{
+public:
+    ECElevatorCar(int numFloors);
+
+    int GetFloor() const { return currFloor; }
+    void SetFloor(int f) { currFloor = f; }
+    EC_ELEVATOR_DIR GetDir() const { return currDir; }
+    void SetDir(EC_ELEVATOR_DIR dir) { currDir = dir; }
+    EC_ELEVATOR_DIR GetSweepDir() const { return sweepDir; } //last direction the car moved in (STOPPED if it never moved)
+
+    const ECElevatorDemandIndex& GetDemand() const { return demand; }
+    int FindClosestRequestFloor() const; //closest floor someone waits at or is headed to (the car's floor if none), as demand.FindClosest
+    int GetNumActive() const { return (int)active.size(); } //passengers waiting for or riding this car
+    const ECElevatorHistory& GetHistory() const { return history; }
+    void SetRecordHistory(bool f) { history.SetRecording(f); }
+    void Save(ECSnapshotWriter& out) const; //checkpoints; the demand index is rebuilt on load from store
+    void Load(ECSnapshotReader& in, const ECElevatorRequestStore& store);
+    const ECElevatorServiceStats& GetServiceStats() const { return serviceStats; } //wait/ride/journey times of passengers this car delivered
+    void BuildState(const ECElevatorRequestStore& store, ECElevatorState& state) const; //where the car is and who waits for/rides it, as the history would show it
+
+    // Take on the request in store slot i, just made: it waits at its floor (or is already on board)
+    void AddRequest(const ECElevatorRequestStore& store, int i);
+
+    // Full logic of one tick: record the state, pick a direction (policy decides unless someone needs this floor),
+    // then move or let ppl on/off
+    // Status changes are written to store and reported to source; serviced requests are retired from store
+    template <class Policy> void Tick(int tm, ECElevatorRequestStore& store, ECElevatorRequestSource& source, const Policy& policy);
+
+    // First time >= tm at which Tick has to run, not counting new requests (INT_MAX if never)
+    template <class Policy> int NextEventTime(int tm, const Policy& policy) const;
+
+    // Record ticks [tmStart, tmEnd) in which Tick would only move the car one floor per tick (or leave it idle)
+    void RecordSpan(int tmStart, int tmEnd);
+
+    //helper
+    bool anyFloorReq(int currFloor) const;
+    bool anyDirReqs(EC_ELEVATOR_DIR move) const;
+    void handleDirectionChange();
+    void handleDirectionChangeHelper(int floorRequested);
+
+private:
+    template <class Policy> void UpdateDirectionAtTime(int tm, const Policy& policy);
+    void UpdateElevatorMovement(const ECElevatorMovement& movement, int tm);
+    void RetireServiced(ECElevatorRequestStore& store);
+
+    int currFloor = 1;
+    EC_ELEVATOR_DIR currDir = EC_ELEVATOR_STOPPED;
+    EC_ELEVATOR_DIR prevMove = EC_ELEVATOR_STOPPED;
+    EC_ELEVATOR_DIR sweepDir = EC_ELEVATOR_STOPPED;
+    ECElevatorDemandIndex demand; //pending hall/car calls of requests assigned to this car
+    std::vector<int> active; //store slots of requests assigned here and not serviced yet, in request order
+    std::vector<int> activeFloors; //activeFloors[a]: floor active[a] needs the car at next (source while waiting, destination on board)
+    ECElevatorHistory history;
+    ECElevatorServiceStats serviceStats;
+};
+
+//*****************************************************************************
+// Direction policy: which way a car goes next
+// Every policy stops a car at any floor where someone waits or wants to get off (they all get on/off
+// there); the policy decides the rest: where to head from a stop and whether to keep going while moving.
+// TicksToDecision tells the event-driven loop how long a moving car can go on without asking again,
+// so it has to agree with NextDirection
+// The built-in policies are final: the simulator's templated loop calls them directly (and inlines
+// them), picking the instantiation once per run from GetType(). Other policies derive from
+// ECElevatorDirectionPolicy and are called through the vtable
+
+typedef enum
+{
+    EC_POLICY_CLASSIC = 0,  // original rule: keep going until a stop, then head for the closest floor with demand
+    EC_POLICY_NEAREST,      // nearest call: always head for the closest floor with demand, even turning around mid-run
+    EC_POLICY_LOOK,         // keep going the same way while anyone needs a floor ahead, then turn around
+    EC_POLICY_SCAN,         // like LOOK, but run to the top/bottom floor before turning around
+    EC_POLICY_CUSTOM        // user defined
+} EC_DIRECTION_POLICY;
+
+class ECElevatorDirectionPolicy
+{
+public:
+    virtual ~ECElevatorDirectionPolicy() {}
+    virtual EC_DIRECTION_POLICY GetType() const { return EC_POLICY_CUSTOM; }
+
+    // Direction for this tick of a car nobody needs to get on/off at its current floor
+    virtual EC_ELEVATOR_DIR NextDirection(const ECElevatorCar& car) const = 0;
+
+    // Ticks a moving car can keep going before NextDirection might say otherwise, not counting new requests (INT_MAX: never)
+    virtual int TicksToDecision(const ECElevatorCar& car) const = 0;
+
+    static const ECElevatorDirectionPolicy& ForType(EC_DIRECTION_POLICY type); //shared built-in instance (classic for CUSTOM)
+    static bool Parse(const std::string& name, EC_DIRECTION_POLICY& type); //classic, nearest, look or scan
+    static const char* GetName(EC_DIRECTION_POLICY type);
+};
+
+class ECElevatorClassicPolicy final : public ECElevatorDirectionPolicy
+{
+public:
+    virtual EC_DIRECTION_POLICY GetType() const override { return EC_POLICY_CLASSIC; }
+    virtual EC_ELEVATOR_DIR NextDirection(const ECElevatorCar& car) const override;
+    virtual int TicksToDecision(const ECElevatorCar& car) const override;
+};
+
+class ECElevatorNearestPolicy final : public ECElevatorDirectionPolicy
+{
+public:
+    virtual EC_DIRECTION_POLICY GetType() const override { return EC_POLICY_NEAREST; }
+    virtual EC_ELEVATOR_DIR NextDirection(const ECElevatorCar& car) const override;
+    virtual int TicksToDecision(const ECElevatorCar& car) const override;
+};
+
+class ECElevatorLookPolicy final : public ECElevatorDirectionPolicy
+{
+public:
+    virtual EC_DIRECTION_POLICY GetType() const override { return EC_POLICY_LOOK; }
+    virtual EC_ELEVATOR_DIR NextDirection(const ECElevatorCar& car) const override;
+    virtual int TicksToDecision(const ECElevatorCar& car) const override;
+};
+
+class ECElevatorScanPolicy final : public ECElevatorDirectionPolicy
+{
+public:
+    virtual EC_DIRECTION_POLICY GetType() const override { return EC_POLICY_SCAN; }
+    virtual EC_ELEVATOR_DIR NextDirection(const ECElevatorCar& car) const override;
+    virtual int TicksToDecision(const ECElevatorCar& car) const override;
+};
+
+//*****************************************************************************
+// Dispatcher: decides which car of a bank answers a hall call
+// Called once per request when it is made; whichever car it picks serves that passenger to the end
+
+class ECElevatorDispatcher
+{
+public:
+    virtual ~ECElevatorDispatcher() {}
+    virtual int AssignCar(const std::vector<ECElevatorCar>& cars, int floorSrc, bool goingUp) = 0; //index into cars
+};
+
+// Car that would get to the caller first, going by how far it has to travel:
+// straight there if idle or already heading that way past the floor in the caller's direction,
+// otherwise out to the last floor it has to serve in its direction and back. Ties go to the lower car
+class ECElevatorNearestCarDispatcher : public ECElevatorDispatcher
+{
+public:
+    virtual int AssignCar(const std::vector<ECElevatorCar>& cars, int floorSrc, bool goingUp) override;
+    static int TravelDistance(const ECElevatorCar& car, int floorSrc, bool goingUp);
 };
 
 //*****************************************************************************
 // Simulation of elevator
+// A bank of one or more cars serving the same floors; with one car (the default) this is the
+// classic single elevator and GetCurrFloor/GetCurrDir/GetHistory describe it. With more cars
+// those refer to car 0 and GetCar gives the others
 
 class ECElevatorSim
 {
@@ -155,6 +558,13 @@ public:
     // numFloors: number of floors serviced (floors numbers from 1 to numFloors)
     ECElevatorSim(int numFloors, std::vector<ECElevatorSimRequest>& listRequests);
 
+    // Pull requests from source as the simulation reaches them (source must outlive the simulator)
+    ECElevatorSim(int numFloors, ECElevatorRequestSource& source);
+
+    // Bank of numCars cars; each hall call goes to the car dispatcher picks (nearest car if nullptr)
+    // The dispatcher, if given, must outlive the simulator
+    ECElevatorSim(int numFloors, int numCars, ECElevatorRequestSource& source, ECElevatorDispatcher* dispatcher = nullptr);
+
     // free buffer
     ~ECElevatorSim() {}
 
@@ -164,6 +574,56 @@ public:
     // at a specific time of simulation, some events may be made in the future (which you shouldn't consider these future requests)
     void Simulate(int lenSim);
 
+    // Event-driven version of Simulate: produces the same per-tick states, but only runs the full
+    // per-tick logic at "interesting" times (a request arriving, a car reaching a floor with demand,
+    // a stop). Idle ticks and plain floor-to-floor moves in between are recorded in one go
+    void SimulateEventDriven(int lenSim);
+
+    // Same as the two above with the direction policy fixed at compile time; with a built-in (final)
+    // policy the per-tick calls are direct and get inlined. Instantiated in ECElevatorSim.cpp for the
+    // built-in policies and for ECElevatorDirectionPolicy itself (virtual calls); other types need a line there
+    template <class Policy> void Simulate(int lenSim, const Policy& policy);
+    template <class Policy> void SimulateEventDriven(int lenSim, const Policy& policy);
+
+    // Ticks simulated so far; Simulate/SimulateEventDriven(lenSim) carry on from here up to lenSim
+    int GetCurrTime() const { return tmNow; }
+
+    // Requests from the source whose time has come, made or dropped (floors out of range), counting those
+    // before a restored checkpoint; the one read ahead and not made yet isn't counted
+    int GetNumRequestsMade() const { return nextReqIndex < 0 ? 0 : nextReqIndex; }
+
+    // Incremental runs (interactive use, live feeds): carry on up to tick tm, or for num more ticks, event driven,
+    // so a step costs what happens in it rather than the whole run so far. A source that ran out is asked again
+    // on the next call, so requests added in between (e.g. appended to the list) are picked up; they should be
+    // made at or after GetCurrTime(), older ones are only seen now (their times still count from when made)
+    void AdvanceTo(int tm) { SimulateEventDriven(tm); }
+    void Step(int num = 1) { SimulateEventDriven(tmNow + num); }
+
+    // Checkpoints: the complete state (clock, cars, requests in flight and their status, recorded
+    // history, statistics, position in the source) as a binary snapshot
+    // Restore into a simulator just built with the same floors, cars and a source that starts from
+    // the beginning of the same requests: the source is skipped forward to where the snapshot was
+    // taken, and simulating on from there gives exactly the results of a run that was never stopped.
+    // A built-in direction policy is restored too. On failure the simulator is left as it was only if
+    // the snapshot header was rejected (error says why); after a corrupt body it has to be thrown away
+    bool SaveCheckpoint(std::ostream& out) const;
+    bool RestoreCheckpoint(std::istream& in, std::string& error);
+
+    // What-if branch: a simulator in the same state that can be simulated on its own from here
+    // Recorded history is shared with this one (in chunks, copied only when a side appends to a shared
+    // chunk); requests in flight, cars and statistics are copied. The fork reads the rest of the requests
+    // through its own cursor over the same data, so that data (e.g. a mapped trace) must outlive it, and
+    // status changes in the fork aren't written back to a request list. Returns nullptr if the source
+    // can't be forked (text streams, result collectors). The fork shares the dispatcher and direction
+    // policy, so they must outlive it too, and it can run on another thread while this one carries on;
+    // just don't call Fork on the same simulator from several threads at once
+    std::unique_ptr<ECElevatorSim> Fork() const;
+
+    // Direction policy of every car, classic unless set; a custom one must outlive the simulator
+    void SetDirectionPolicy(EC_DIRECTION_POLICY type) { dirPolicy = &ECElevatorDirectionPolicy::ForType(type); }
+    void SetDirectionPolicy(const ECElevatorDirectionPolicy& policy) { dirPolicy = &policy; }
+    const ECElevatorDirectionPolicy& GetDirectionPolicy() const { return *dirPolicy; }
+
     // The following methods are about querying/setting states of the elevator
     // which include (i) number of floors of the elevator, 
     // (ii) the current floor: which is the elevator at right now (at the time of this querying). Note: we don't model the tranisent states like when the elevator is between two floors
@@ -172,36 +632,69 @@ public:
     // Get num of floors
     int GetNumFloors() const { return numFloors; }
 
-    int GetCurrFloor() const { return currFloor; } // Get current floor
-    void SetCurrFloor(int f) { currFloor = f; } // Set current floor
+    int GetCurrFloor() const { return cars[0].GetFloor(); } // Get current floor
+    void SetCurrFloor(int f) { cars[0].SetFloor(f); } // Set current floor
 
-    EC_ELEVATOR_DIR GetCurrDir() const { return currDir; } // Get current direction
-    void SetCurrDir(EC_ELEVATOR_DIR dir) { currDir = dir; } // Set current direction
+    EC_ELEVATOR_DIR GetCurrDir() const { return cars[0].GetDir(); } // Get current direction
+    void SetCurrDir(EC_ELEVATOR_DIR dir) { cars[0].SetDir(dir); } // Set current direction
 
-    const std::vector<ECElevatorState>& GetallStates() const { return recordedStates; }
+    // Cars of the bank
+    int GetNumCars() const { return (int)cars.size(); }
+    const ECElevatorCar& GetCar(int i) const { return cars[i]; }
+    ECElevatorCar& GetCar(int i) { return cars[i]; } //e.g. to send a forked simulator's car the other way
 
-    //helper
-    bool anyFloorReq(int const time, int currFloor) const;
-    bool anyDirReqs(EC_ELEVATOR_DIR move, int time) const;
-    void handleDirectionChange(int time);
-    void handleDirectionChangeHelper(ECElevatorSimRequest requestParameter);
-    const std::vector<ECElevatorState>& GetAllStates() const { return recordedStates; }
+    // Recorded states: use GetHistory().GetState(tm) for any tick; GetAllStates() builds every
+    // tick's state at once so only use it for short runs
+    const ECElevatorHistory& GetHistory() const { return cars[0].GetHistory(); }
+    void SetRecordHistory(bool f); //turn off before simulating if nobody needs the states
 
-private:
-    std::vector<ECElevatorSimRequest>& requests;
-    int currFloor;
-    int numFloors;
-    EC_ELEVATOR_DIR currDir;
-    EC_ELEVATOR_DIR prevMove = EC_ELEVATOR_STOPPED;
+    // State of car c at the start of tick GetCurrTime(), the same as its history will hold for that tick, built
+    // from the car itself so it works with recording off. Takes in the requests made at that tick first (the
+    // next Simulate would do it anyway), hence not const
+    void BuildCurrState(ECElevatorState& state, int c = 0);
 
-    std::vector<ECElevatorState> recordedStates;
+    // Wait, ride and journey time distributions of every request serviced so far (all cars together);
+    // kept up to date as passengers arrive, so they are there even with history recording off
+    ECElevatorServiceStats GetServiceStats() const;
 
-    void RecordState(int time);
+    // Requests in flight (made, not serviced yet) with their current status; see GetId for their index
+    const ECElevatorRequestStore& GetRequests() const { return store; }
+    std::vector<ECElevatorState> GetAllStates() const;
 
-    void UpdateDirectionAtTime(int tm);
-    void UpdateElevatorMovement(ECElevatorMovement* movement, int tm);
+    //helper
+    bool anyFloorReq(int currFloor) const { return cars[0].anyFloorReq(currFloor); }
+    bool anyDirReqs(EC_ELEVATOR_DIR move) const { return cars[0].anyDirReqs(move); }
+    void handleDirectionChange() { cars[0].handleDirectionChange(); }
+    void handleDirectionChangeHelper(int floorRequested) { cars[0].handleDirectionChangeHelper(floorRequested); }
+
+private:
+    std::unique_ptr<ECElevatorRequestSource> ownedSource; //when built from a list
+    ECElevatorRequestSource* source; //where requests come from; told about every status change
+    ECElevatorRequestStore store; //requests in flight: what the simulation actually reads and updates
+    int numFloors;
 
-    int findClosestRequestFloor(int currFloor, int time) const;
+    std::vector<ECElevatorCar> cars;
+    std::unique_ptr<ECElevatorDispatcher> ownedDispatcher; //when none is given
+    ECElevatorDispatcher* dispatcher;
+    const ECElevatorDirectionPolicy* dirPolicy;
+
+    int tmNow = 0; //next tick to simulate
+    ECElevatorSimRequest nextReq{ 0, 0, 0 }; //arrival cursor: next request from the source, not made yet
+    bool hasNextReq = false;
+    int nextReqIndex = -1;
+
+    ECElevatorSim(const ECElevatorSim& parent, std::unique_ptr<ECElevatorRequestSource> sourceIn); //for Fork
+    void Init(int numCars, ECElevatorDispatcher* dispatcherIn);
+
+    template <class Fn> void WithPolicy(Fn fn) const; //fn(policy) with dirPolicy as its final type if it is a built-in one
+    template <class Policy> void SimulateTick(int tm, const Policy& policy);
+    void ActivateRequests(int tm);
+    void FetchNextRequest();
+    void PollSource();
+    bool IsValidRequest(const ECElevatorSimRequest& req) const;
+    template <class Policy> int NextEventTime(int tm, const Policy& policy) const;
+    int NextArrivalTime() const;
+    void RecordSpan(int tmStart, int tmEnd);
 };
 
 
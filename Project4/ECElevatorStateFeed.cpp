@@ -0,0 +1,60 @@
+//
+//  ECElevatorStateFeed.cpp
+//
+
+#include "ECElevatorStateFeed.h"
+
+using namespace std;
+
+ECElevatorStateFeed::ECElevatorStateFeed(ECElevatorSim& sim, int lenSim, int capacity) :
+    sim(sim), lenSim(lenSim), slots(max(capacity, 2)), tmPublished(sim.GetCurrTime()), tmFirst(sim.GetCurrTime()), tmReleased(sim.GetCurrTime())
+{
+    worker = thread(&ECElevatorStateFeed::WorkerLoop, this);
+}
+
+ECElevatorStateFeed::~ECElevatorStateFeed()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    slotFree.notify_one();
+    worker.join();
+}
+
+void ECElevatorStateFeed::WorkerLoop()
+{
+    const int capacity = (int)slots.size();
+    for (int tm = tmPublished.load(memory_order_relaxed); tm < lenSim; tm++)
+    {
+        if (tm - tmReleased.load(memory_order_acquire) >= capacity) //ring full: wait for the reader
+        {
+            unique_lock<mutex> guard(lock);
+            slotFree.wait(guard, [&] { return stopping || tm - tmReleased.load(memory_order_acquire) < capacity; });
+            if (stopping) { return; }
+        }
+        else if (stopping) { return; }
+
+        sim.BuildCurrState(slots[tm % capacity], 0);
+        tmPublished.store(tm + 1, memory_order_release);
+        sim.Step();
+    }
+}
+
+const ECElevatorState* ECElevatorStateFeed::GetState(int tm) const
+{
+    if (tm < tmFirst || tm >= tmPublished.load(memory_order_acquire)) { return nullptr; }
+    return &slots[tm % slots.size()];
+}
+
+void ECElevatorStateFeed::ReleaseBefore(int tm)
+{
+    tm = min(tm, tmPublished.load(memory_order_acquire)); //can't give back what the worker hasn't filled yet
+    if (tm <= tmFirst) { return; }
+    tmFirst = tm;
+    {
+        lock_guard<mutex> guard(lock); //so the worker can't miss the wakeup between its check and its wait
+        tmReleased.store(tm, memory_order_release);
+    }
+    slotFree.notify_one();
+}
@@ -0,0 +1,62 @@
+//
+//  ECElevatorStateFeed.h
+//
+
+#ifndef ECElevatorStateFeed_h
+#define ECElevatorStateFeed_h
+
+#include "ECElevatorSim.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Runs a simulator on a worker thread and hands its states to one reader (the view) as they come
+// The worker simulates tick by tick and puts each tick's state (car 0) into a ring of capacity
+// slots; when the reader falls that far behind the worker waits, so however long the run only
+// capacity states exist at once and the simulator needs no recorded history. The reader looks at
+// ticks still in the ring and gives them back once it has moved past them. The slots are reused,
+// so the steady state allocates next to nothing
+//
+// One reader thread only; the simulator must not be touched by anyone else until the feed is gone
+
+class ECElevatorStateFeed
+{
+public:
+    // Starts simulating from sim.GetCurrTime() up to lenSim right away
+    ECElevatorStateFeed(ECElevatorSim& sim, int lenSim, int capacity = 1024);
+    ~ECElevatorStateFeed(); //stops the worker (wherever it is) and joins it
+    ECElevatorStateFeed(const ECElevatorStateFeed&) = delete;
+    ECElevatorStateFeed& operator=(const ECElevatorStateFeed&) = delete;
+
+    // State of tick tm, or nullptr if it isn't simulated yet or was already released.
+    // Stays valid until tm is released
+    const ECElevatorState* GetState(int tm) const;
+
+    // Reader is done with every tick before tm; their slots go back to the worker
+    void ReleaseBefore(int tm);
+
+    int GetFirstTime() const { return tmFirst; } //oldest tick not released
+    int GetNumReady() const { return tmPublished.load(std::memory_order_acquire) - tmFirst; } //states simulated and not released
+    bool IsDone() const { return tmPublished.load(std::memory_order_acquire) >= lenSim; } //every tick up to lenSim is in (or was)
+
+private:
+    void WorkerLoop();
+
+    ECElevatorSim& sim;
+    const int lenSim;
+    std::vector<ECElevatorState> slots; //tick tm lives in slot tm % capacity
+
+    std::atomic<int> tmPublished; //ticks before this are in their slots; written by the worker
+    int tmFirst; //ticks before this are released; written by the reader
+    std::atomic<int> tmReleased; //copy of tmFirst for the worker
+
+    std::mutex lock; //only for sleeping: the worker waits on slotFree when the ring is full
+    std::condition_variable slotFree;
+    std::atomic<bool> stopping{ false };
+    std::thread worker;
+};
+
+#endif /* ECElevatorStateFeed_h */
@@ -0,0 +1,125 @@
+//
+//  ECElevatorStats.cpp
+//
+
+#include "ECElevatorStats.h"
+#include "ECSimSnapshot.h"
+#include <cmath>
+#include <climits>
+
+using namespace std;
+
+//*****************************************************************************
+// ECLatencyHistogram
+
+//position of the highest set bit of v (v > 0)
+static int HighestBit(unsigned v)
+{
+    int bit = 0;
+    while (v >>= 1) { bit++; }
+    return bit;
+}
+
+int ECLatencyHistogram::BucketOf(int value)
+{
+    if (value < ExactBuckets) { return value; }
+    int bit = HighestBit((unsigned)value); //4..30
+    int shift = bit - SubBucketBits;
+    int sub = (value >> shift) & ((1 << SubBucketBits) - 1); //next bits below the top one
+    return ExactBuckets + ((bit - 4) << SubBucketBits) + sub;
+}
+
+int ECLatencyHistogram::BucketUpperBound(int bucket)
+{
+    if (bucket < ExactBuckets) { return bucket; }
+    int bit = 4 + ((bucket - ExactBuckets) >> SubBucketBits);
+    int sub = (bucket - ExactBuckets) & ((1 << SubBucketBits) - 1);
+    int shift = bit - SubBucketBits;
+    long long upper = ((long long)((1 << SubBucketBits) + sub + 1) << shift) - 1;
+    return upper > INT_MAX ? INT_MAX : (int)upper;
+}
+
+void ECLatencyHistogram::Record(int value)
+{
+    if (value < 0) { value = 0; }
+    buckets[BucketOf(value)]++;
+    count++;
+    sum += value;
+    if (value > maxValue) { maxValue = value; }
+}
+
+void ECLatencyHistogram::Merge(const ECLatencyHistogram& rhs)
+{
+    for (int b = 0; b < NumBuckets; b++)
+    {
+        buckets[b] += rhs.buckets[b];
+    }
+    count += rhs.count;
+    sum += rhs.sum;
+    if (rhs.maxValue > maxValue) { maxValue = rhs.maxValue; }
+}
+
+int ECLatencyHistogram::GetPercentile(double pct) const
+{
+    if (count == 0) { return 0; }
+    long long rank = (long long)ceil(pct / 100.0 * count); //how many values must be at or below the answer
+    if (rank < 1) { rank = 1; }
+    long long seen = 0;
+    for (int b = 0; b < NumBuckets; b++)
+    {
+        seen += buckets[b];
+        if (seen >= rank)
+        {
+            int upper = BucketUpperBound(b);
+            return upper < maxValue ? upper : maxValue;
+        }
+    }
+    return maxValue;
+}
+
+void ECLatencyHistogram::Save(ECSnapshotWriter& out) const
+{
+    out.Put(buckets);
+    out.Put(count);
+    out.Put(sum);
+    out.Put(maxValue);
+}
+
+void ECLatencyHistogram::Load(ECSnapshotReader& in)
+{
+    buckets = in.Get<std::array<long long, NumBuckets>>();
+    count = in.Get<long long>();
+    sum = in.Get<long long>();
+    maxValue = in.Get<int>();
+}
+
+//*****************************************************************************
+// ECElevatorServiceStats
+
+void ECElevatorServiceStats::RecordServiced(int timeMade, int timeBoarded, int timeArrived)
+{
+    wait.Record(timeBoarded - timeMade);
+    ride.Record(timeArrived - timeBoarded);
+    journey.Record(timeArrived - timeMade);
+}
+
+void ECElevatorServiceStats::Merge(const ECElevatorServiceStats& rhs)
+{
+    wait.Merge(rhs.wait);
+    ride.Merge(rhs.ride);
+    journey.Merge(rhs.journey);
+}
+
+void ECElevatorServiceStats::Save(ECSnapshotWriter& out) const
+{
+    wait.Save(out);
+    ride.Save(out);
+    journey.Save(out);
+}
+
+void ECElevatorServiceStats::Load(ECSnapshotReader& in)
+{
+    wait.Load(in);
+    ride.Load(in);
+    journey.Load(in);
+}
@@ -0,0 +1,73 @@
+//
+//  ECElevatorStats.h
+//
+
+#ifndef ECElevatorStats_h
+#define ECElevatorStats_h
+
+#include <array>
+
+class ECSnapshotWriter;
+class ECSnapshotReader;
+
+//*****************************************************************************
+// Streaming histogram of tick counts
+// Values below 16 get a bucket each; above that every power of two is split into 8 buckets,
+// so a percentile is off by at most 1/8 of its value. Recording is a few bit operations and
+// the whole thing is a fixed ~2KB, however many values go in
+
+class ECLatencyHistogram
+{
+public:
+    void Record(int value); //negative values count as 0
+    void Merge(const ECLatencyHistogram& rhs);
+
+    long long GetCount() const { return count; }
+    double GetMean() const { return count > 0 ? (double)sum / count : 0.0; }
+    int GetMax() const { return maxValue; }
+    int GetPercentile(double pct) const; //smallest bucket bound that covers pct% of values (0 if empty); never above GetMax()
+
+    //checkpoints
+    void Save(ECSnapshotWriter& out) const;
+    void Load(ECSnapshotReader& in);
+
+private:
+    static const int ExactBuckets = 16; //values [0, 16) are exact
+    static const int SubBucketBits = 3; //8 buckets per power of two above that
+    static const int NumBuckets = ExactBuckets + (31 - 4) * (1 << SubBucketBits);
+
+    static int BucketOf(int value);
+    static int BucketUpperBound(int bucket);
+
+    std::array<long long, NumBuckets> buckets{};
+    long long count = 0;
+    long long sum = 0;
+    int maxValue = 0;
+};
+
+//*****************************************************************************
+// Service times of serviced requests, kept as they arrive
+// wait: request made -> boarded, ride: boarded -> arrived, journey: request made -> arrived
+
+class ECElevatorServiceStats
+{
+public:
+    void RecordServiced(int timeMade, int timeBoarded, int timeArrived);
+    void Merge(const ECElevatorServiceStats& rhs);
+
+    long long GetNumServiced() const { return journey.GetCount(); }
+    const ECLatencyHistogram& GetWait() const { return wait; }
+    const ECLatencyHistogram& GetRide() const { return ride; }
+    const ECLatencyHistogram& GetJourney() const { return journey; }
+
+    //checkpoints
+    void Save(ECSnapshotWriter& out) const;
+    void Load(ECSnapshotReader& in);
+
+private:
+    ECLatencyHistogram wait;
+    ECLatencyHistogram ride;
+    ECLatencyHistogram journey;
+};
+
+#endif /* ECElevatorStats_h */
@@ -0,0 +1,347 @@
+//
+//  ECElevatorTrace.cpp
+//
+
+#include "ECElevatorTrace.h"
+#include "ECTrafficGenerator.h"
+#include <sstream>
+#include <fstream>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+//skip blanks, then read an int (a leading '+' is allowed, as with >>); advances p past it
+static bool ParseInt(const char*& p, const char* end, int& val)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) { p++; }
+    if (p < end && *p == '+' && p + 1 < end && *(p + 1) != '-') { p++; }
+    auto res = std::from_chars(p, end, val);
+    if (res.ec != std::errc()) { return false; }
+    p = res.ptr;
+    return true;
+}
+
+static bool IsBlank(const char* p, const char* end)
+{
+    for (; p < end; p++)
+    {
+        if (*p != ' ' && *p != '\t' && *p != '\r') { return false; }
+    }
+    return true;
+}
+
+ECElevatorTextSource::ECElevatorTextSource(std::istream& in) : in(in)
+{
+    if (NextLine())
+    {
+        const char* p = line.data();
+        const char* end = p + line.size();
+        headerValid = ParseInt(p, end, numFloors) && ParseInt(p, end, lenSim);
+    }
+}
+
+bool ECElevatorTextSource::NextLine()
+{
+    while (getline(in, line))
+    {
+        if (!line.empty() && line[0] != '#' && !IsBlank(line.data(), line.data() + line.size())) { return true; } //dont read comments or blank lines
+    }
+    return false;
+}
+
+bool ECElevatorTextSource::Next(ECElevatorSimRequest& req)
+{
+    while (NextLine())
+    {
+        const char* p = line.data();
+        const char* end = p + line.size();
+        int t, src, dest;
+        if (ParseInt(p, end, t) && ParseInt(p, end, src) && ParseInt(p, end, dest))
+        {
+            req = ECElevatorSimRequest(t, src, dest);
+            return true;
+        }
+    }
+    return false;
+}
+
+//*****************************************************************************
+// ECElevatorTraceLoader
+
+bool ECElevatorTraceLoader::Load(const std::string& filename)
+{
+    ECMappedFile file(filename);
+    if (!file.IsOpen())
+    {
+        AddError(0, "can't open file: " + filename);
+        return false;
+    }
+    return Parse(file.GetData(), file.GetSize());
+}
+
+bool ECElevatorTraceLoader::Parse(const char* data, size_t size)
+{
+    const char* p = data;
+    const char* end = data + size;
+    bool haveHeader = false;
+    if (keepRequests) { requests.reserve(requests.size() + size / 12); } //short request lines are ~10 bytes
+
+    for (int lineNum = 1; p < end; lineNum++)
+    {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == nullptr) { eol = end; }
+        const char* line = p;
+        p = eol + 1;
+
+        if (line == eol || *line == '#' || IsBlank(line, eol)) { continue; } //dont read comments
+
+        if (!haveHeader) //first real line: numFloors lenSim
+        {
+            if (!ParseInt(line, eol, numFloors) || !ParseInt(line, eol, lenSim))
+            {
+                AddError(lineNum, "expected \"numFloors lenSim\"");
+                return false;
+            }
+            haveHeader = true;
+            continue;
+        }
+
+        int t, src, dest;
+        if (ParseInt(line, eol, t) && ParseInt(line, eol, src) && ParseInt(line, eol, dest))
+        {
+            if (numRequests++ > 0 && t < lastTime) { timeSorted = false; }
+            lastTime = t;
+            if (keepRequests) { requests.push_back(ECElevatorSimRequest(t, src, dest)); }
+        }
+        else
+        {
+            AddError(lineNum, "expected \"time floorSrc floorDest\"");
+        }
+    }
+
+    if (!haveHeader) { AddError(0, "missing \"numFloors lenSim\" line"); }
+    return haveHeader;
+}
+
+void ECElevatorTraceLoader::AddError(int line, const std::string& message)
+{
+    if (numErrors++ < MaxErrorsKept) { errors.push_back(ECTraceError{ line, message }); }
+}
+
+//*****************************************************************************
+// ECElevatorBinaryTrace
+
+static_assert(sizeof(ECTraceHeader) == 24 && sizeof(ECTraceRecord) == 12, "binary trace layout must not have padding");
+
+bool ECElevatorBinaryTrace::Write(const std::string& filename, int numFloors, int lenSim, std::vector<ECElevatorSimRequest> requests)
+{
+    std::stable_sort(requests.begin(), requests.end(), [](const ECElevatorSimRequest& a, const ECElevatorSimRequest& b) { return a.GetTime() < b.GetTime(); });
+    ECElevatorVectorSource source(requests);
+    return ECElevatorTraceWriter::WriteBinary(filename, numFloors, lenSim, source);
+}
+
+bool ECElevatorBinaryTrace::Convert(const std::string& textFile, const std::string& binFile, std::vector<ECTraceError>& errors)
+{
+    ECElevatorTraceLoader loader;
+    bool loaded = loader.Load(textFile);
+    errors = loader.GetErrors();
+    if (!loaded) { return false; }
+    if (!Write(binFile, loader.GetNumFloors(), loader.GetLenSim(), std::move(loader.GetRequests())))
+    {
+        errors.push_back(ECTraceError{ 0, "can't write file: " + binFile });
+        return false;
+    }
+    return true;
+}
+
+bool ECElevatorBinaryTrace::Open(const std::string& filename)
+{
+    header = nullptr;
+    records = nullptr;
+    file.reset(new ECMappedFile(filename));
+    if (!file->IsOpen())
+    {
+        error = "can't open file: " + filename;
+        return false;
+    }
+
+    const ECTraceHeader* hdr = (const ECTraceHeader*)file->GetData();
+    if (file->GetSize() < sizeof(ECTraceHeader) || memcmp(hdr->magic, "ECTR", 4) != 0)
+    {
+        error = "not a binary trace: " + filename;
+        return false;
+    }
+    if (hdr->version != Version)
+    {
+        error = "unsupported binary trace version " + to_string(hdr->version) + ": " + filename;
+        return false;
+    }
+    if ((file->GetSize() - sizeof(ECTraceHeader)) / sizeof(ECTraceRecord) < hdr->numRecords)
+    {
+        error = "binary trace is truncated: " + filename;
+        return false;
+    }
+
+    header = hdr;
+    records = (const ECTraceRecord*)(file->GetData() + sizeof(ECTraceHeader));
+    return true;
+}
+
+bool ECElevatorBinarySource::Next(ECElevatorSimRequest& req)
+{
+    if (pos >= trace.GetNumRecords()) { return false; }
+    const ECTraceRecord& rec = trace.GetRecords()[pos++];
+    req = ECElevatorSimRequest(rec.time, rec.floorSrc, rec.floorDest);
+    return true;
+}
+
+int ECElevatorBinarySource::Skip(int num)
+{
+    size_t skipped = std::min((size_t)std::max(num, 0), (size_t)trace.GetNumRecords() - pos);
+    pos += skipped;
+    return (int)skipped;
+}
+
+std::unique_ptr<ECElevatorRequestSource> ECElevatorBinarySource::Fork() const
+{
+    ECElevatorBinarySource* fork = new ECElevatorBinarySource(trace);
+    fork->pos = pos;
+    return std::unique_ptr<ECElevatorRequestSource>(fork);
+}
+
+//*****************************************************************************
+// ECElevatorTraceInput
+
+bool ECElevatorTraceInput::Open(const std::string& filename, bool stream)
+{
+    if (filename.compare(0, 4, "gen:") == 0) //generated traffic
+    {
+        ECTrafficConfig config;
+        string error;
+        if (!config.Parse(filename.substr(4), error))
+        {
+            errors.push_back(ECTraceError{ 0, error });
+            numErrors = 1;
+            return false;
+        }
+        numFloors = config.numFloors;
+        lenSim = config.lenSim;
+        trafficSpec = config.ToString();
+        source.reset(new ECTrafficGenerator(config));
+        return true;
+    }
+
+    if (binTrace.Open(filename))
+    {
+        numFloors = binTrace.GetNumFloors();
+        lenSim = binTrace.GetLenSim();
+        source.reset(new ECElevatorBinarySource(binTrace));
+        return true;
+    }
+
+    if (stream) { loader.SetKeepRequests(false); } //first just check the lines (and their order)
+    bool loaded = loader.Load(filename);
+    errors = loader.GetErrors();
+    numErrors = loader.GetNumErrors();
+    if (!loaded) { return false; }
+    numFloors = loader.GetNumFloors();
+    lenSim = loader.GetLenSim();
+
+    if (stream && loader.IsTimeSorted()) //already in order: read it line by line as the simulation goes
+    {
+        textIn.open(filename, ios::binary);
+        if (textIn)
+        {
+            source.reset(new ECElevatorTextSource(textIn));
+            return true;
+        }
+    }
+    if (!loader.GetKeepRequests()) //out of order: load it all after all
+    {
+        loader = ECElevatorTraceLoader();
+        if (!loader.Load(filename))
+        {
+            errors = loader.GetErrors();
+            numErrors = loader.GetNumErrors();
+            return false;
+        }
+    }
+    std::vector<ECElevatorSimRequest>& requests = loader.GetRequests();
+
+    //sorting requests by time (stable, so requests made at the same time keep their file order, as in a binary trace)
+    std::stable_sort(requests.begin(), requests.end(), [](const ECElevatorSimRequest& a, const ECElevatorSimRequest& b) {
+        return a.GetTime() < b.GetTime();
+        });
+    source.reset(new ECElevatorVectorSource(requests));
+    return true;
+}
+
+//*****************************************************************************
+// ECElevatorTraceWriter
+
+bool ECElevatorTraceWriter::Write(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source)
+{
+    bool binary = filename.size() >= 8 && filename.compare(filename.size() - 8, 8, ".ectrace") == 0;
+    return binary ? WriteBinary(filename, numFloors, lenSim, source) : WriteText(filename, numFloors, lenSim, source);
+}
+
+bool ECElevatorTraceWriter::WriteText(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source)
+{
+    ofstream out(filename, ios::binary);
+    if (!out) { return false; }
+    out << numFloors << " " << lenSim << "\n";
+
+    string block; //format into one buffer and write it out in large pieces
+    block.reserve(1 << 16);
+    char num[16];
+    auto append = [&block, &num](int val, char sep) {
+        auto res = std::to_chars(num, num + sizeof(num), val);
+        block.append(num, res.ptr);
+        block += sep;
+    };
+    ECElevatorSimRequest req(0, 0, 0);
+    while (source.Next(req))
+    {
+        append(req.GetTime(), ' ');
+        append(req.GetFloorSrc(), ' ');
+        append(req.GetFloorDest(), '\n');
+        if (block.size() > (1 << 16) - 64)
+        {
+            out.write(block.data(), block.size());
+            block.clear();
+        }
+    }
+    out.write(block.data(), block.size());
+    return (bool)out;
+}
+
+bool ECElevatorTraceWriter::WriteBinary(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source)
+{
+    ofstream out(filename, ios::binary);
+    if (!out) { return false; }
+
+    ECTraceHeader hdr{ { 'E', 'C', 'T', 'R' }, ECElevatorBinaryTrace::Version, numFloors, lenSim, 0 };
+    out.write((const char*)&hdr, sizeof(hdr)); //record count is filled in at the end
+
+    vector<ECTraceRecord> block; //write in blocks rather than one record at a time
+    block.reserve(4096);
+    ECElevatorSimRequest req(0, 0, 0);
+    bool more = true;
+    while (more)
+    {
+        more = source.Next(req);
+        if (more) { block.push_back(ECTraceRecord{ req.GetTime(), req.GetFloorSrc(), req.GetFloorDest() }); }
+        if (block.size() == block.capacity() || (!more && !block.empty()))
+        {
+            out.write((const char*)block.data(), block.size() * sizeof(ECTraceRecord));
+            hdr.numRecords += block.size();
+            block.clear();
+        }
+    }
+
+    out.seekp(0);
+    out.write((const char*)&hdr, sizeof(hdr));
+    return (bool)out;
+}
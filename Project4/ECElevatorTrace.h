@@ -0,0 +1,201 @@
+//
+//  ECElevatorTrace.h
+//
+
+#ifndef ECElevatorTrace_h
+#define ECElevatorTrace_h
+
+#include "ECElevatorSim.h"
+#include "ECMappedFile.h"
+#include <istream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+//*****************************************************************************
+// Request source reading a text trace (same format as test1.txt) as the simulation goes
+// First non-comment line: numFloors lenSim; then one "time floorSrc floorDest" per line.
+// Lines starting with '#' and blank lines are skipped, as are lines that don't parse.
+// Lines are parsed as ECElevatorTraceLoader parses them, so both read the same requests.
+// Nothing is kept once a request is handed out, so the trace must already be in time order
+// (a request that comes late is made as soon as the simulation reads it)
+
+class ECElevatorTextSource : public ECElevatorRequestSource
+{
+public:
+    ECElevatorTextSource(std::istream& in); //reads the header line right away
+    virtual bool Next(ECElevatorSimRequest& req) override;
+
+    bool IsHeaderValid() const { return headerValid; }
+    int GetNumFloors() const { return numFloors; }
+    int GetLenSim() const { return lenSim; }
+
+private:
+    bool NextLine(); //next line that isn't empty or a comment into line
+
+    std::istream& in;
+    std::string line;
+    bool headerValid = false;
+    int numFloors = 0;
+    int lenSim = 0;
+};
+
+//*****************************************************************************
+// Fast loader for a whole text trace (same format and comment rules as above)
+// The file is memory mapped and parsed in place with std::from_chars: no per-line string or
+// stream is built. A request line that doesn't start with three integers is skipped and
+// reported with its line number (the first MaxErrorsKept are kept, all are counted).
+// With SetKeepRequests(false) the lines are only checked: nothing is stored, but errors and
+// IsTimeSorted still come out, e.g. to tell whether the trace can be streamed as it is
+
+struct ECTraceError
+{
+    int line; //1-based line number in the file
+    std::string message;
+};
+
+class ECElevatorTraceLoader
+{
+public:
+    static const int MaxErrorsKept = 100;
+
+    bool Load(const std::string& filename); //false if the file can't be read or has no header line
+    bool Parse(const char* data, size_t size); //same, from text already in memory
+    void SetKeepRequests(bool f) { keepRequests = f; }
+    bool GetKeepRequests() const { return keepRequests; }
+
+    int GetNumFloors() const { return numFloors; }
+    int GetLenSim() const { return lenSim; }
+    std::vector<ECElevatorSimRequest>& GetRequests() { return requests; } //in file order
+    bool IsTimeSorted() const { return timeSorted; } //request times never go down, in file order
+    const std::vector<ECTraceError>& GetErrors() const { return errors; }
+    int GetNumErrors() const { return numErrors; }
+
+private:
+    void AddError(int line, const std::string& message);
+
+    int numFloors = 0;
+    int lenSim = 0;
+    bool keepRequests = true;
+    bool timeSorted = true;
+    size_t numRequests = 0;
+    int lastTime = 0;
+    std::vector<ECElevatorSimRequest> requests;
+    std::vector<ECTraceError> errors;
+    int numErrors = 0;
+};
+
+//*****************************************************************************
+// Binary trace format (version 1), little-endian:
+//   header: "ECTR", uint32 version, int32 numFloors, int32 lenSim, uint64 numRecords  (24 bytes)
+//   then numRecords records of int32 time, floorSrc, floorDest (12 bytes each), sorted by time
+// Records are read straight out of the memory-mapped file, so opening a trace costs the same
+// whatever its size; pages are only read in as the simulation gets to them
+
+struct ECTraceHeader
+{
+    char magic[4];
+    uint32_t version;
+    int32_t numFloors;
+    int32_t lenSim;
+    uint64_t numRecords;
+};
+
+struct ECTraceRecord
+{
+    int32_t time;
+    int32_t floorSrc;
+    int32_t floorDest;
+};
+
+class ECElevatorBinaryTrace
+{
+public:
+    static const uint32_t Version = 1;
+
+    // Write requests (sorted by time first, keeping file order for equal times); false if the file can't be written
+    static bool Write(const std::string& filename, int numFloors, int lenSim, std::vector<ECElevatorSimRequest> requests);
+
+    // Text trace -> binary trace; bad text lines are reported as by ECElevatorTraceLoader
+    static bool Convert(const std::string& textFile, const std::string& binFile, std::vector<ECTraceError>& errors);
+
+    // Map a binary trace; false (with a reason in GetError) if it isn't one or is cut short
+    bool Open(const std::string& filename);
+
+    int GetNumFloors() const { return header->numFloors; }
+    int GetLenSim() const { return header->lenSim; }
+    size_t GetNumRecords() const { return (size_t)header->numRecords; }
+    const ECTraceRecord* GetRecords() const { return records; }
+    const std::string& GetError() const { return error; }
+
+private:
+    std::unique_ptr<ECMappedFile> file;
+    const ECTraceHeader* header = nullptr;
+    const ECTraceRecord* records = nullptr;
+    std::string error;
+};
+
+// Request source reading the records of an open binary trace in place
+class ECElevatorBinarySource : public ECElevatorRequestSource
+{
+public:
+    ECElevatorBinarySource(const ECElevatorBinaryTrace& trace) : trace(trace) {}
+    virtual bool Next(ECElevatorSimRequest& req) override;
+    virtual int Skip(int num) override;
+    virtual std::unique_ptr<ECElevatorRequestSource> Fork() const override; //reads the same mapped records
+
+private:
+    const ECElevatorBinaryTrace& trace;
+    size_t pos = 0;
+};
+
+//*****************************************************************************
+// Writes the requests of any source (e.g. a traffic generator) to a trace file, as they come
+// The source must already be in time order; nothing is buffered beyond one output block
+
+class ECElevatorTraceWriter
+{
+public:
+    static bool Write(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source); //binary if the name ends in .ectrace, else text
+    static bool WriteText(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source);
+    static bool WriteBinary(const std::string& filename, int numFloors, int lenSim, ECElevatorRequestSource& source);
+};
+
+//*****************************************************************************
+// A trace of any kind, ready to simulate
+// Binary traces are mapped and read in place; text traces are loaded with ECElevatorTraceLoader
+// and stable-sorted by time, or, when opened to stream and already in time order, checked once and
+// then read line by line (ECElevatorTextSource) so a big trace is never held in memory whole.
+// Streamed text can't be forked, so only stream for straight runs. "gen:<traffic spec>" (see
+// ECTrafficConfig::Parse) generates the requests on the fly instead of reading a file.
+// GetSource feeds the requests to ECElevatorSim
+
+class ECElevatorTraceInput
+{
+public:
+    bool Open(const std::string& filename, bool stream = false); //false if it doesn't load; see GetErrors
+
+    int GetNumFloors() const { return numFloors; }
+    int GetLenSim() const { return lenSim; }
+    ECElevatorRequestSource& GetSource() { return *source; }
+    const std::string& GetTrafficSpec() const { return trafficSpec; } //generated traffic: the full spec (ECTrafficConfig::ToString); empty for files
+
+    // Problems found while loading (text lines that were skipped, or why it failed)
+    const std::vector<ECTraceError>& GetErrors() const { return errors; }
+    int GetNumErrors() const { return numErrors; }
+
+private:
+    ECElevatorBinaryTrace binTrace;
+    ECElevatorTraceLoader loader;
+    std::ifstream textIn; //streamed text trace
+    std::unique_ptr<ECElevatorRequestSource> source;
+    int numFloors = 0;
+    int lenSim = 0;
+    std::string trafficSpec;
+    std::vector<ECTraceError> errors;
+    int numErrors = 0;
+};
+
+#endif /* ECElevatorTrace_h */
@@ -0,0 +1,271 @@
+//
+//  ECFloorKernels.cpp
+//
+
+#include "ECFloorKernels.h"
+#include <climits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define EC_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define EC_TARGET_SSE41
+#define EC_TARGET_AVX2
+#else
+#define EC_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define EC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace std;
+
+//*****************************************************************************
+// Scalar versions (also used for the tail that doesn't fill a whole vector)
+
+static bool AnyAboveScalar(const int* floors, int begin, int count, int floor)
+{
+    for (int i = begin; i < count; i++)
+    {
+        if (floors[i] > floor) { return true; }
+    }
+    return false;
+}
+
+static bool AnyBelowScalar(const int* floors, int begin, int count, int floor)
+{
+    for (int i = begin; i < count; i++)
+    {
+        if (floors[i] < floor) { return true; }
+    }
+    return false;
+}
+
+//distance of floors[i] from floor, INT_MAX when outside [floorMin, floorMax]
+static int DistanceScalar(int f, int floor, int floorMin, int floorMax)
+{
+    return (f < floorMin || f > floorMax) ? INT_MAX : (f > floor ? f - floor : floor - f);
+}
+
+static int MinDistanceScalar(const int* floors, int begin, int count, int floor, int floorMin, int floorMax, int best)
+{
+    for (int i = begin; i < count; i++)
+    {
+        int dist = DistanceScalar(floors[i], floor, floorMin, floorMax);
+        if (dist < best) { best = dist; }
+    }
+    return best;
+}
+
+static int FirstWithDistanceScalar(const int* floors, int begin, int count, int floor, int floorMin, int floorMax, int dist)
+{
+    for (int i = begin; i < count; i++)
+    {
+        if (DistanceScalar(floors[i], floor, floorMin, floorMax) == dist) { return i; }
+    }
+    return -1;
+}
+
+#ifdef EC_SIMD_X86
+
+//*****************************************************************************
+// SSE4.1: 4 floors at a time
+
+EC_TARGET_SSE41 static bool AnyAboveSSE41(const int* floors, int count, int floor)
+{
+    __m128i ref = _mm_set1_epi32(floor);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(floors + i));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi32(v, ref))) { return true; }
+    }
+    return AnyAboveScalar(floors, i, count, floor);
+}
+
+EC_TARGET_SSE41 static bool AnyBelowSSE41(const int* floors, int count, int floor)
+{
+    __m128i ref = _mm_set1_epi32(floor);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(floors + i));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi32(ref, v))) { return true; }
+    }
+    return AnyBelowScalar(floors, i, count, floor);
+}
+
+EC_TARGET_SSE41 static __m128i DistanceSSE41(__m128i v, __m128i ref, __m128i lo, __m128i hi, __m128i none)
+{
+    __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(lo, v), _mm_cmpgt_epi32(v, hi));
+    __m128i dist = _mm_abs_epi32(_mm_sub_epi32(v, ref));
+    return _mm_blendv_epi8(dist, none, outside);
+}
+
+EC_TARGET_SSE41 static int FindClosestSSE41(const int* floors, int count, int floor, int floorMin, int floorMax)
+{
+    __m128i ref = _mm_set1_epi32(floor), lo = _mm_set1_epi32(floorMin), hi = _mm_set1_epi32(floorMax), none = _mm_set1_epi32(INT_MAX);
+
+    //pass 1: smallest distance
+    __m128i best = none;
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        best = _mm_min_epi32(best, DistanceSSE41(_mm_loadu_si128((const __m128i*)(floors + i)), ref, lo, hi, none));
+    }
+    best = _mm_min_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(1, 0, 3, 2)));
+    best = _mm_min_epi32(best, _mm_shuffle_epi32(best, _MM_SHUFFLE(2, 3, 0, 1)));
+    int bestDist = MinDistanceScalar(floors, i, count, floor, floorMin, floorMax, _mm_cvtsi128_si32(best));
+    if (bestDist == INT_MAX) { return floor; }
+
+    //pass 2: first floor at that distance
+    __m128i target = _mm_set1_epi32(bestDist);
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        __m128i dist = DistanceSSE41(_mm_loadu_si128((const __m128i*)(floors + i)), ref, lo, hi, none);
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(dist, target)));
+        if (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane))) { lane++; }
+            return floors[i + lane];
+        }
+    }
+    return floors[FirstWithDistanceScalar(floors, i, count, floor, floorMin, floorMax, bestDist)];
+}
+
+//*****************************************************************************
+// AVX2: 8 floors at a time
+
+EC_TARGET_AVX2 static bool AnyAboveAVX2(const int* floors, int count, int floor)
+{
+    __m256i ref = _mm256_set1_epi32(floor);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(floors + i));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(v, ref))) { return true; }
+    }
+    return AnyAboveScalar(floors, i, count, floor);
+}
+
+EC_TARGET_AVX2 static bool AnyBelowAVX2(const int* floors, int count, int floor)
+{
+    __m256i ref = _mm256_set1_epi32(floor);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(floors + i));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi32(ref, v))) { return true; }
+    }
+    return AnyBelowScalar(floors, i, count, floor);
+}
+
+EC_TARGET_AVX2 static __m256i DistanceAVX2(__m256i v, __m256i ref, __m256i lo, __m256i hi, __m256i none)
+{
+    __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lo, v), _mm256_cmpgt_epi32(v, hi));
+    __m256i dist = _mm256_abs_epi32(_mm256_sub_epi32(v, ref));
+    return _mm256_blendv_epi8(dist, none, outside);
+}
+
+EC_TARGET_AVX2 static int FindClosestAVX2(const int* floors, int count, int floor, int floorMin, int floorMax)
+{
+    __m256i ref = _mm256_set1_epi32(floor), lo = _mm256_set1_epi32(floorMin), hi = _mm256_set1_epi32(floorMax), none = _mm256_set1_epi32(INT_MAX);
+
+    //pass 1: smallest distance
+    __m256i best = none;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        best = _mm256_min_epi32(best, DistanceAVX2(_mm256_loadu_si256((const __m256i*)(floors + i)), ref, lo, hi, none));
+    }
+    __m128i best4 = _mm_min_epi32(_mm256_castsi256_si128(best), _mm256_extracti128_si256(best, 1));
+    best4 = _mm_min_epi32(best4, _mm_shuffle_epi32(best4, _MM_SHUFFLE(1, 0, 3, 2)));
+    best4 = _mm_min_epi32(best4, _mm_shuffle_epi32(best4, _MM_SHUFFLE(2, 3, 0, 1)));
+    int bestDist = MinDistanceScalar(floors, i, count, floor, floorMin, floorMax, _mm_cvtsi128_si32(best4));
+    if (bestDist == INT_MAX) { return floor; }
+
+    //pass 2: first floor at that distance
+    __m256i target = _mm256_set1_epi32(bestDist);
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        __m256i dist = DistanceAVX2(_mm256_loadu_si256((const __m256i*)(floors + i)), ref, lo, hi, none);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(dist, target)));
+        if (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane))) { lane++; }
+            return floors[i + lane];
+        }
+    }
+    return floors[FirstWithDistanceScalar(floors, i, count, floor, floorMin, floorMax, bestDist)];
+}
+
+#endif
+
+//*****************************************************************************
+// Dispatch
+
+EC_SIMD_LEVEL ECFloorKernels::level = ECFloorKernels::GetBestLevel();
+
+EC_SIMD_LEVEL ECFloorKernels::GetBestLevel()
+{
+#if defined(EC_SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6); //OS saves the AVX registers
+    __cpuidex(info, 7, 0);
+    bool avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+    return avx2 ? EC_SIMD_AVX2 : (sse41 ? EC_SIMD_SSE41 : EC_SIMD_SCALAR);
+#elif defined(EC_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { return EC_SIMD_AVX2; }
+    if (__builtin_cpu_supports("sse4.1")) { return EC_SIMD_SSE41; }
+    return EC_SIMD_SCALAR;
+#else
+    return EC_SIMD_SCALAR;
+#endif
+}
+
+void ECFloorKernels::SetLevel(EC_SIMD_LEVEL lvl)
+{
+    EC_SIMD_LEVEL best = GetBestLevel();
+    level = lvl > best ? best : lvl;
+}
+
+const char* ECFloorKernels::GetLevelName(EC_SIMD_LEVEL lvl)
+{
+    if (lvl == EC_SIMD_AVX2) { return "avx2"; }
+    if (lvl == EC_SIMD_SSE41) { return "sse4.1"; }
+    return "scalar";
+}
+
+bool ECFloorKernels::AnyAbove(const int* floors, int count, int floor)
+{
+#ifdef EC_SIMD_X86
+    if (level == EC_SIMD_AVX2) { return AnyAboveAVX2(floors, count, floor); }
+    if (level == EC_SIMD_SSE41) { return AnyAboveSSE41(floors, count, floor); }
+#endif
+    return AnyAboveScalar(floors, 0, count, floor);
+}
+
+bool ECFloorKernels::AnyBelow(const int* floors, int count, int floor)
+{
+#ifdef EC_SIMD_X86
+    if (level == EC_SIMD_AVX2) { return AnyBelowAVX2(floors, count, floor); }
+    if (level == EC_SIMD_SSE41) { return AnyBelowSSE41(floors, count, floor); }
+#endif
+    return AnyBelowScalar(floors, 0, count, floor);
+}
+
+int ECFloorKernels::FindClosest(const int* floors, int count, int floor, int floorMin, int floorMax)
+{
+#ifdef EC_SIMD_X86
+    if (level == EC_SIMD_AVX2) { return FindClosestAVX2(floors, count, floor, floorMin, floorMax); }
+    if (level == EC_SIMD_SSE41) { return FindClosestSSE41(floors, count, floor, floorMin, floorMax); }
+#endif
+    int bestDist = MinDistanceScalar(floors, 0, count, floor, floorMin, floorMax, INT_MAX);
+    if (bestDist == INT_MAX) { return floor; }
+    return floors[FirstWithDistanceScalar(floors, 0, count, floor, floorMin, floorMax, bestDist)];
+}
@@ -0,0 +1,45 @@
+//
+//  ECFloorKernels.h
+//
+
+#ifndef ECFloorKernels_h
+#define ECFloorKernels_h
+
+//*****************************************************************************
+// Vectorized scans over a contiguous array of requested floors
+// These are the reductions behind anyDirReqs and FindClosestRequestFloor when they are done
+// by scanning requests: is any floor above/below the car, and which floor is closest to it.
+// ECElevatorCar scans its activeFloors this way while it has only a few active requests (the
+// demand index answers faster past that)
+// Each kernel has a scalar, SSE4.1 and AVX2 version; the best one the CPU supports is picked
+// at runtime (SetLevel can force a lower one, e.g. for benchmarking)
+
+typedef enum
+{
+    EC_SIMD_SCALAR = 0,     // plain loop, works everywhere
+    EC_SIMD_SSE41,          // 4 floors per instruction
+    EC_SIMD_AVX2            // 8 floors per instruction
+} EC_SIMD_LEVEL;
+
+class ECFloorKernels
+{
+public:
+    // Best level this CPU supports / level in use (defaults to the best one)
+    static EC_SIMD_LEVEL GetBestLevel();
+    static EC_SIMD_LEVEL GetLevel() { return level; }
+    static void SetLevel(EC_SIMD_LEVEL lvl); //clamped to GetBestLevel()
+    static const char* GetLevelName(EC_SIMD_LEVEL lvl);
+
+    // Is any of floors[0..count) above (below) floor?
+    static bool AnyAbove(const int* floors, int count, int floor);
+    static bool AnyBelow(const int* floors, int count, int floor);
+
+    // Closest of floors[0..count) to floor, only counting floors in [floorMin, floorMax];
+    // on a tie the one that comes first wins. Returns floor if there is none
+    static int FindClosest(const int* floors, int count, int floor, int floorMin, int floorMax);
+
+private:
+    static EC_SIMD_LEVEL level;
+};
+
+#endif /* ECFloorKernels_h */
@@ -0,0 +1,222 @@
+//
+//  ECLabelCache.cpp
+//
+
+#include "ECLabelCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+static const int MAX_SHEET_WIDTH = 1024; //labels wrap onto a new row past this
+
+void ECLabelCache::AddNumbers(ALLEGRO_FONT* font, ECGVColor color, int first, int last)
+{
+    if (!font || first > last) { return; }
+    Sheet& sheet = sheets[make_pair(font, (int)color)];
+    if (sheet.numbers.empty())
+    {
+        sheet.firstNumber = first;
+        sheet.numbers.resize(last - first + 1);
+    }
+    else //widen the range already there
+    {
+        int lastNumber = sheet.firstNumber + (int)sheet.numbers.size() - 1;
+        int newFirst = min(first, sheet.firstNumber);
+        int newLast = max(last, lastNumber);
+        if (newFirst == sheet.firstNumber && newLast == lastNumber) { return; }
+        sheet.numbers.insert(sheet.numbers.begin(), sheet.firstNumber - newFirst, Label());
+        sheet.numbers.resize(newLast - newFirst + 1);
+        sheet.firstNumber = newFirst;
+    }
+    sheet.stale = true;
+}
+
+void ECLabelCache::AddString(ALLEGRO_FONT* font, ECGVColor color, const string& text)
+{
+    if (!font || text.empty()) { return; }
+    Sheet& sheet = sheets[make_pair(font, (int)color)];
+    if (sheet.strings.emplace(text, Label()).second) { sheet.stale = true; }
+}
+
+ECLabelCache::Sheet* ECLabelCache::GetReadySheet(ALLEGRO_FONT* font, ECGVColor color)
+{
+    auto it = sheets.find(make_pair(font, (int)color));
+    if (it == sheets.end()) { return nullptr; }
+    if (it->second.stale) { Render(font, color, it->second); }
+    return it->second.bitmap ? &it->second : nullptr;
+}
+
+//lay every label of the group out in rows and draw them all into one fresh bitmap
+void ECLabelCache::Render(ALLEGRO_FONT* font, ECGVColor color, Sheet& sheet)
+{
+    sheet.stale = false;
+    sheet.bitmap.reset();
+
+    //place each label by its ink box, a pixel of margin all round so filtering never picks up a neighbour
+    int x = 0, y = 0, rowH = 0, sheetW = 0;
+    char digits[16];
+    auto place = [&](const char* text, Label& label)
+    {
+        int bbx, bby, bbw, bbh;
+        al_get_text_dimensions(font, text, &bbx, &bby, &bbw, &bbh);
+        label.w = bbw + 2;
+        label.h = bbh + 2;
+        label.offsetX = bbx - 1;
+        label.offsetY = bby - 1;
+        label.advance = al_get_text_width(font, text);
+        if (x > 0 && x + label.w > MAX_SHEET_WIDTH)
+        {
+            x = 0;
+            y += rowH;
+            rowH = 0;
+        }
+        label.x = x;
+        label.y = y;
+        x += label.w;
+        rowH = max(rowH, label.h);
+        sheetW = max(sheetW, x);
+    };
+    for (int i = 0; i < (int)sheet.numbers.size(); i++)
+    {
+        snprintf(digits, sizeof(digits), "%d", sheet.firstNumber + i);
+        place(digits, sheet.numbers[i]);
+    }
+    for (auto& entry : sheet.strings)
+    {
+        place(entry.first.c_str(), entry.second);
+    }
+    int sheetH = y + rowH;
+    if (sheetW == 0 || sheetH == 0) { return; }
+
+    sheet.bitmap = shared_ptr<ALLEGRO_BITMAP>(al_create_bitmap(sheetW, sheetH), al_destroy_bitmap);
+    if (!sheet.bitmap)
+    {
+        cout << "Failed to create a label sheet, drawing those labels as text" << endl;
+        return;
+    }
+
+    //drawing may be held by the caller; it can't stay held across a change of target
+    bool held = al_is_bitmap_drawing_held();
+    if (held) { al_hold_bitmap_drawing(false); }
+    ALLEGRO_BITMAP* prevTarget = al_get_target_bitmap();
+    al_set_target_bitmap(sheet.bitmap.get());
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+    for (int i = 0; i < (int)sheet.numbers.size(); i++)
+    {
+        const Label& label = sheet.numbers[i];
+        snprintf(digits, sizeof(digits), "%d", sheet.firstNumber + i);
+        al_draw_text(font, arrayAllegroColors[color], label.x - label.offsetX, label.y - label.offsetY, 0, digits);
+    }
+    for (auto& entry : sheet.strings)
+    {
+        const Label& label = entry.second;
+        al_draw_text(font, arrayAllegroColors[color], label.x - label.offsetX, label.y - label.offsetY, 0, entry.first.c_str());
+    }
+    al_set_target_bitmap(prevTarget);
+    if (held) { al_hold_bitmap_drawing(true); }
+}
+
+const ECLabelCache::Label* ECLabelCache::FindNumber(const Sheet* sheet, int value)
+{
+    if (!sheet) { return nullptr; }
+    int index = value - sheet->firstNumber;
+    if (index < 0 || index >= (int)sheet->numbers.size()) { return nullptr; }
+    return &sheet->numbers[index];
+}
+
+const ECLabelCache::Label* ECLabelCache::FindString(const Sheet* sheet, const char* text)
+{
+    if (!sheet) { return nullptr; }
+    auto it = sheet->strings.find(text);
+    return it == sheet->strings.end() ? nullptr : &it->second;
+}
+
+int ECLabelCache::DigitsAdvance(const Sheet* sheet, const char* digits)
+{
+    int advance = 0;
+    for (const char* p = digits; *p; p++)
+    {
+        const Label* label = (*p >= '0' && *p <= '9') ? FindNumber(sheet, *p - '0') : nullptr;
+        if (!label) { return -1; }
+        advance += label->advance;
+    }
+    return advance;
+}
+
+void ECLabelCache::Blit(const Sheet& sheet, const Label& label, float x, float y)
+{
+    al_draw_bitmap_region(sheet.bitmap.get(), label.x, label.y, label.w, label.h, x + label.offsetX, y + label.offsetY, 0);
+}
+
+void ECLabelCache::DrawNumberAt(ALLEGRO_FONT* font, ECGVColor color, const Sheet* sheet, int value, float x, float y)
+{
+    if (const Label* label = FindNumber(sheet, value))
+    {
+        Blit(*sheet, *label, x, y);
+        return;
+    }
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%d", value);
+    if (DigitsAdvance(sheet, digits) < 0) //not all the digits are cached
+    {
+        al_draw_text(font, arrayAllegroColors[color], x, y, 0, digits);
+        return;
+    }
+    for (const char* p = digits; *p; p++) //digit by digit (no kerning between them)
+    {
+        const Label& label = *FindNumber(sheet, *p - '0');
+        Blit(*sheet, label, x, y);
+        x += label.advance;
+    }
+}
+
+void ECLabelCache::Draw(ALLEGRO_FONT* font, ECGVColor color, int value, float xcenter, float y)
+{
+    if (!font) { return; }
+    Sheet* sheet = GetReadySheet(font, color);
+    if (const Label* label = FindNumber(sheet, value))
+    {
+        Blit(*sheet, *label, xcenter - label->advance / 2.0f, y);
+        return;
+    }
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%d", value);
+    int advance = DigitsAdvance(sheet, digits);
+    if (advance < 0) { advance = al_get_text_width(font, digits); }
+    DrawNumberAt(font, color, sheet, value, xcenter - advance / 2.0f, y);
+}
+
+void ECLabelCache::Draw(ALLEGRO_FONT* font, ECGVColor color, const char* text, float xcenter, float y)
+{
+    if (!font) { return; }
+    Sheet* sheet = GetReadySheet(font, color);
+    if (const Label* label = FindString(sheet, text))
+    {
+        Blit(*sheet, *label, xcenter - label->advance / 2.0f, y);
+        return;
+    }
+    al_draw_text(font, arrayAllegroColors[color], xcenter, y, ALLEGRO_ALIGN_CENTER, text);
+}
+
+void ECLabelCache::Draw(ALLEGRO_FONT* font, ECGVColor color, const char* prefix, int value, float xcenter, float y)
+{
+    if (!font) { return; }
+    Sheet* sheet = GetReadySheet(font, color);
+    const Label* prefixLabel = FindString(sheet, prefix);
+    char digits[16];
+    snprintf(digits, sizeof(digits), "%d", value);
+    const Label* numberLabel = FindNumber(sheet, value);
+    int numberAdvance = numberLabel ? numberLabel->advance : DigitsAdvance(sheet, digits);
+    if (!prefixLabel || numberAdvance < 0) //not all cached: draw it as one string
+    {
+        char text[128];
+        snprintf(text, sizeof(text), "%s%s", prefix, digits);
+        al_draw_text(font, arrayAllegroColors[color], xcenter, y, ALLEGRO_ALIGN_CENTER, text);
+        return;
+    }
+    float x = xcenter - (prefixLabel->advance + numberAdvance) / 2.0f;
+    Blit(*sheet, *prefixLabel, x, y);
+    DrawNumberAt(font, color, sheet, value, x + prefixLabel->advance, y);
+}
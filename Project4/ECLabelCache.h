@@ -0,0 +1,65 @@
+//
+//  ECLabelCache.h
+//
+
+#ifndef ECLabelCache_h
+#define ECLabelCache_h
+
+#include "ECGraphicViewImp.h"
+#include <allegro5/allegro_font.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+//*****************************************************************************
+// Text labels rendered once into a bitmap, then drawn as a single blit each
+// Labels are grouped by font and colour; each group is one sheet (one texture), so a run of labels
+// from the same group batches under al_hold_bitmap_drawing. Register what will be drawn up front:
+// a range of integers (floor numbers, destinations) and fixed strings (button captions); a group's
+// sheet is rendered on its first use after something was added to it. Drawing looks the label up
+// without building a string; an integer outside the cached range is put together from the cached
+// digits 0..9 if those are there, and anything else not cached is drawn as plain text
+// Needs the display (and the fonts) to exist; one thread only. A null font draws nothing
+
+class ECLabelCache
+{
+public:
+    void AddNumbers(ALLEGRO_FONT* font, ECGVColor color, int first, int last);
+    void AddString(ALLEGRO_FONT* font, ECGVColor color, const std::string& text);
+
+    // Centred on xcenter with its top at y, like ECGraphicViewImp::DrawTextFont
+    void Draw(ALLEGRO_FONT* font, ECGVColor color, int value, float xcenter, float y);
+    void Draw(ALLEGRO_FONT* font, ECGVColor color, const char* text, float xcenter, float y);
+    void Draw(ALLEGRO_FONT* font, ECGVColor color, const char* prefix, int value, float xcenter, float y); //e.g. "Time: " and the time, centred together
+
+private:
+    struct Label
+    {
+        int x = 0, y = 0, w = 0, h = 0; //ink box (plus a pixel each side) in the sheet
+        int offsetX = 0, offsetY = 0; //where the box sits relative to the text's origin
+        int advance = 0; //width of the text, for centring and placing what follows
+    };
+
+    struct Sheet
+    {
+        int firstNumber = 0;
+        std::vector<Label> numbers; //numbers[value - firstNumber]
+        std::map<std::string, Label, std::less<>> strings; //less<> so lookups take a const char* as is
+        std::shared_ptr<ALLEGRO_BITMAP> bitmap;
+        bool stale = false; //texts added since the bitmap was rendered
+    };
+
+    Sheet* GetReadySheet(ALLEGRO_FONT* font, ECGVColor color); //rendered and up to date, nullptr if no such group
+    void Render(ALLEGRO_FONT* font, ECGVColor color, Sheet& sheet);
+    static const Label* FindNumber(const Sheet* sheet, int value);
+    static const Label* FindString(const Sheet* sheet, const char* text);
+    static int DigitsAdvance(const Sheet* sheet, const char* digits); //-1 if a digit isn't cached
+    void DrawNumberAt(ALLEGRO_FONT* font, ECGVColor color, const Sheet* sheet, int value, float x, float y); //x: left edge
+    static void Blit(const Sheet& sheet, const Label& label, float x, float y); //x, y: the text's origin
+
+    std::map<std::pair<ALLEGRO_FONT*, int>, Sheet> sheets;
+};
+
+#endif /* ECLabelCache_h */
@@ -0,0 +1,144 @@
+//
+//  ECLockFreeQueue.h
+//
+
+#ifndef ECLockFreeQueue_h
+#define ECLockFreeQueue_h
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+//*****************************************************************************
+// Bounded lock-free queues for handing items to one consumer thread
+// Both are fixed rings (capacity rounded up to a power of two) allocated once; a push never waits
+// and never allocates, it just fails when the ring is full. The index each side writes sits on its
+// own cache line so producers and the consumer don't keep stealing each other's line
+
+static const size_t ECCacheLineSize = 64;
+
+static inline size_t ECRoundUpPow2(size_t n)
+{
+    size_t cap = 1;
+    while (cap < n) { cap <<= 1; }
+    return cap;
+}
+
+// One producer thread, one consumer thread
+// Each side keeps a stale copy of the other's index and only reloads it when the ring looks full
+// (or empty), so most pushes and pops touch nothing the other thread writes
+
+template <class T>
+class ECSpscQueue
+{
+public:
+    ECSpscQueue(size_t capacity) : mask(ECRoundUpPow2(capacity < 1 ? 1 : capacity) - 1), slots(new T[mask + 1]) {}
+    ECSpscQueue(const ECSpscQueue&) = delete;
+    ECSpscQueue& operator=(const ECSpscQueue&) = delete;
+
+    size_t GetCapacity() const { return mask + 1; }
+
+    bool TryPush(const T& item) //producer thread only
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCache > mask)
+        {
+            headCache = head.load(std::memory_order_acquire);
+            if (t - headCache > mask) { return false; } //full
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t GetSize() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed); } //consumer thread: items pushed and not popped yet
+
+    bool TryPop(T& item) //consumer thread only
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCache)
+        {
+            tailCache = tail.load(std::memory_order_acquire);
+            if (h == tailCache) { return false; } //empty
+        }
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(ECCacheLineSize) std::atomic<size_t> tail{ 0 }; //written by the producer
+    size_t headCache = 0; //producer's copy of head
+    alignas(ECCacheLineSize) std::atomic<size_t> head{ 0 }; //written by the consumer
+    size_t tailCache = 0; //consumer's copy of tail
+};
+
+// Any number of producer threads, one consumer thread
+// Each slot carries a sequence number saying whose turn it is: producers claim a slot by moving the
+// tail on with a compare-exchange, fill it, then publish it by bumping its sequence; the consumer
+// takes slots in order once published. A producer that is preempted between claiming and publishing
+// holds up the consumer at that slot, but never the other producers
+
+template <class T>
+class ECMpscQueue
+{
+public:
+    ECMpscQueue(size_t capacity) : mask(ECRoundUpPow2(capacity < 1 ? 1 : capacity) - 1), cells(new Cell[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; i++) { cells[i].seq.store(i, std::memory_order_relaxed); }
+    }
+    ECMpscQueue(const ECMpscQueue&) = delete;
+    ECMpscQueue& operator=(const ECMpscQueue&) = delete;
+
+    size_t GetCapacity() const { return mask + 1; }
+
+    bool TryPush(const T& item) //any thread
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) //free for pos: try to claim it
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            }
+            else if (diff < 0) { return false; } //still holds the item from a lap ago: full
+            else { pos = tail.load(std::memory_order_relaxed); } //another producer got there first
+        }
+        cell->item = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t GetSize() const { return tail.load(std::memory_order_acquire) - head; } //consumer thread: slots claimed and not popped yet (the last few may not be filled in yet)
+
+    bool TryPop(T& item) //consumer thread only
+    {
+        Cell& cell = cells[head & mask];
+        if (cell.seq.load(std::memory_order_acquire) != head + 1) { return false; } //empty (or not published yet)
+        item = cell.item;
+        cell.seq.store(head + mask + 1, std::memory_order_release); //free for the producers' next lap
+        head++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T item;
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(ECCacheLineSize) std::atomic<size_t> tail{ 0 }; //shared by the producers
+    alignas(ECCacheLineSize) size_t head = 0; //consumer's own
+};
+
+#endif /* ECLockFreeQueue_h */
@@ -0,0 +1,79 @@
+//
+//  ECMappedFile.cpp
+//
+
+#include "ECMappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+ECMappedFile::ECMappedFile(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) { return; }
+    hFile = file;
+
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(file, &len)) { return; }
+    size = (size_t)len.QuadPart;
+    if (size == 0) //can't map an empty file, but there is nothing to read either
+    {
+        open = true;
+        return;
+    }
+
+    hMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (hMapping == NULL) { return; }
+    data = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    open = data != nullptr;
+}
+
+ECMappedFile::~ECMappedFile()
+{
+    if (data != nullptr) { UnmapViewOfFile(data); }
+    if (hMapping != nullptr) { CloseHandle(hMapping); }
+    if (hFile != nullptr) { CloseHandle(hFile); }
+}
+
+#else
+
+ECMappedFile::ECMappedFile(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        size = (size_t)st.st_size;
+        if (size == 0) { open = true; } //can't map an empty file, but there is nothing to read either
+        else
+        {
+            void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, size, MADV_SEQUENTIAL);
+                data = (const char*)p;
+                open = true;
+            }
+        }
+    }
+    close(fd); //the mapping keeps its own reference to the file
+}
+
+ECMappedFile::~ECMappedFile()
+{
+    if (data != nullptr) { munmap((void*)data, size); }
+}
+
+#endif
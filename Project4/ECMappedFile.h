@@ -0,0 +1,38 @@
+//
+//  ECMappedFile.h
+//
+
+#ifndef ECMappedFile_h
+#define ECMappedFile_h
+
+#include <string>
+#include <cstddef>
+
+//*****************************************************************************
+// Read-only memory mapping of a whole file
+// The OS pages the file in on demand, so opening is cheap no matter the size and nothing is copied
+// An empty file opens fine with GetSize() == 0
+
+class ECMappedFile
+{
+public:
+    ECMappedFile(const std::string& filename);
+    ~ECMappedFile();
+    ECMappedFile(const ECMappedFile&) = delete;
+    ECMappedFile& operator=(const ECMappedFile&) = delete;
+
+    bool IsOpen() const { return open; }
+    const char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    bool open = false;
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* hFile = nullptr;
+    void* hMapping = nullptr;
+#endif
+};
+
+#endif /* ECMappedFile_h */
@@ -0,0 +1,122 @@
+//
+//  ECScenarioRunner.cpp
+//
+
+#include "ECScenarioRunner.h"
+#include "ECThreadPool.h"
+#include "ECElevatorTrace.h"
+#include "ECElevatorHeadless.h"
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+ECScenarioRunner::ECScenarioRunner(int numThreads) : numThreads(numThreads > 0 ? numThreads : max(1, (int)thread::hardware_concurrency())) {}
+
+const std::vector<ECScenarioResult>& ECScenarioRunner::Run()
+{
+    results.assign(scenarios.size(), ECScenarioResult());
+    {
+        ECThreadPool pool(numThreads);
+        for (size_t i = 0; i < scenarios.size(); i++)
+        {
+            pool.Submit([this, i] { results[i] = RunOne(scenarios[i]); }); //each task writes only its own slot
+        }
+        pool.WaitIdle();
+    }
+    return results;
+}
+
+ECScenarioResult ECScenarioRunner::RunOne(const ECScenario& scenario)
+{
+    auto start = chrono::steady_clock::now();
+    ECScenarioResult res;
+    res.scenario = scenario;
+
+    ECElevatorTraceInput trace;
+    if (!trace.Open(scenario.traceFile, true)) //a straight run, so text traces in time order are streamed
+    {
+        res.error = trace.GetErrors().empty() ? "can't load trace" : trace.GetErrors().back().message;
+        return res;
+    }
+
+    ECElevatorResultCollector collector(trace.GetSource());
+    ECElevatorSim sim(trace.GetNumFloors(), scenario.numCars, collector);
+    sim.SetRecordHistory(false);
+    sim.SetDirectionPolicy(scenario.policy);
+    sim.SimulateEventDriven(trace.GetLenSim());
+
+    res.ok = true;
+    res.numFloors = trace.GetNumFloors();
+    res.lenSim = trace.GetLenSim();
+    res.trafficSpec = trace.GetTrafficSpec();
+    res.numRequests = sim.GetNumRequestsMade();
+    res.numServiced = collector.GetNumServiced();
+    res.numUnfinished = sim.GetRequests().GetNumInUse();
+    res.avgJourney = collector.GetAvgJourney();
+    res.maxJourney = collector.GetMaxJourney();
+    ECElevatorServiceStats stats = sim.GetServiceStats();
+    res.waitP50 = stats.GetWait().GetPercentile(50);
+    res.waitP90 = stats.GetWait().GetPercentile(90);
+    res.waitP99 = stats.GetWait().GetPercentile(99);
+    res.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return res;
+}
+
+//quote a string for CSV (only if needed) or JSON
+static string QuoteCSV(const string& str)
+{
+    if (str.find_first_of(",\"\n") == string::npos) { return str; }
+    string out = "\"";
+    for (char c : str)
+    {
+        if (c == '"') { out += '"'; }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static string QuoteJSON(const string& str)
+{
+    string out = "\"";
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '\n') { out += "\\n"; }
+        else if ((unsigned char)c < 0x20) { out += ' '; }
+        else { out += c; }
+    }
+    return out + "\"";
+}
+
+void ECScenarioRunner::WriteCSV(std::ostream& out, const std::vector<ECScenarioResult>& results)
+{
+    out << "trace,cars,policy,ok,floors,lenSim,requests,serviced,unfinished,avgJourney,maxJourney,waitP50,waitP90,waitP99,elapsedMs,error\n";
+    for (auto& res : results)
+    {
+        out << QuoteCSV(res.scenario.traceFile) << ',' << res.scenario.numCars << ',' << ECElevatorDirectionPolicy::GetName(res.scenario.policy) << ',' << (res.ok ? 1 : 0) << ',' << res.numFloors << ',' << res.lenSim << ','
+            << res.numRequests << ',' << res.numServiced << ',' << res.numUnfinished << ',' << res.avgJourney << ',' << res.maxJourney << ','
+            << res.waitP50 << ',' << res.waitP90 << ',' << res.waitP99 << ',' << res.elapsedMs << ',' << QuoteCSV(res.error) << '\n';
+    }
+    out.flush();
+}
+
+void ECScenarioRunner::WriteJSON(std::ostream& out, const std::vector<ECScenarioResult>& results, double totalMs, int numThreads)
+{
+    out << "{\n  \"threads\": " << numThreads << ",\n  \"totalMs\": " << totalMs << ",\n  \"scenarios\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ECScenarioResult& res = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"trace\": " << QuoteJSON(res.scenario.traceFile);
+        if (!res.trafficSpec.empty()) { out << ", \"spec\": " << QuoteJSON("gen:" + res.trafficSpec); }
+        out << ", \"cars\": " << res.scenario.numCars
+            << ", \"policy\": \"" << ECElevatorDirectionPolicy::GetName(res.scenario.policy) << "\""
+            << ", \"ok\": " << (res.ok ? "true" : "false") << ", \"floors\": " << res.numFloors << ", \"lenSim\": " << res.lenSim
+            << ", \"requests\": " << res.numRequests << ", \"serviced\": " << res.numServiced << ", \"unfinished\": " << res.numUnfinished
+            << ", \"avgJourney\": " << res.avgJourney << ", \"maxJourney\": " << res.maxJourney
+            << ", \"waitP50\": " << res.waitP50 << ", \"waitP90\": " << res.waitP90 << ", \"waitP99\": " << res.waitP99 << ", \"elapsedMs\": " << res.elapsedMs;
+        if (!res.ok) { out << ", \"error\": " << QuoteJSON(res.error); }
+        out << "}";
+    }
+    out << "\n  ]\n}" << endl;
+}
@@ -0,0 +1,66 @@
+//
+//  ECScenarioRunner.h
+//
+
+#ifndef ECScenarioRunner_h
+#define ECScenarioRunner_h
+
+#include "ECElevatorSim.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+//*****************************************************************************
+// Runs many independent simulations at once
+// Each scenario (a trace file, a bank size and a direction policy) is loaded and simulated headless, with no
+// history kept, as one task on a work-stealing thread pool. Scenarios share nothing, so
+// throughput grows with the number of cores. Results come back in the order scenarios were added
+
+struct ECScenario
+{
+    std::string traceFile;
+    int numCars = 1;
+    EC_DIRECTION_POLICY policy = EC_POLICY_CLASSIC;
+};
+
+struct ECScenarioResult
+{
+    ECScenario scenario;
+    bool ok = false;
+    std::string error; //why the trace didn't load
+    std::string trafficSpec; //generated traffic: the spec with every default filled in
+    int numFloors = 0;
+    int lenSim = 0;
+    long long numRequests = 0; //made by the end (ECElevatorSim::GetNumRequestsMade)
+    long long numServiced = 0;
+    long long numUnfinished = 0; //still waiting or riding at the end
+    double avgJourney = 0; //request made -> arrived, serviced requests only
+    int maxJourney = 0;
+    int waitP50 = 0; //request made -> boarded, percentiles over serviced requests
+    int waitP90 = 0;
+    int waitP99 = 0;
+    double elapsedMs = 0; //load + simulate
+};
+
+class ECScenarioRunner
+{
+public:
+    ECScenarioRunner(int numThreads = 0); //0: one per hardware thread
+
+    void Add(const ECScenario& scenario) { scenarios.push_back(scenario); }
+    const std::vector<ECScenarioResult>& Run(); //runs everything added so far
+    int GetNumThreads() const { return numThreads; }
+
+    static ECScenarioResult RunOne(const ECScenario& scenario);
+
+    // Report: one row/object per scenario
+    static void WriteCSV(std::ostream& out, const std::vector<ECScenarioResult>& results);
+    static void WriteJSON(std::ostream& out, const std::vector<ECScenarioResult>& results, double totalMs, int numThreads);
+
+private:
+    int numThreads;
+    std::vector<ECScenario> scenarios;
+    std::vector<ECScenarioResult> results;
+};
+
+#endif /* ECScenarioRunner_h */
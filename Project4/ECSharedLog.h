@@ -0,0 +1,103 @@
+//
+//  ECSharedLog.h
+//
+
+#ifndef ECSharedLog_h
+#define ECSharedLog_h
+
+#include "ECSimSnapshot.h"
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+//*****************************************************************************
+// Append-only array in fixed-size chunks that copies share
+// Only the last chunk is ever written, and every log owns its last chunk outright: copying a log
+// shares the chunk pointers but copies the last chunk. So a copy of a long log costs a pointer per
+// chunk plus one chunk, and a shared chunk is never written by anyone, which is what lets copies
+// be used from different threads (without relying on use_count, which says nothing about what
+// the other owners have read). Making the copy reads the source, so that needs the source's thread
+// Indexing is a shift and a mask; ChunkBits sets the chunk size (2^ChunkBits items)
+
+template <class T, int ChunkBits>
+class ECSharedLog
+{
+public:
+    ECSharedLog() = default;
+    ECSharedLog(const ECSharedLog& other) : chunks(other.chunks), numItems(other.numItems) { OwnLastChunk(); }
+    ECSharedLog& operator=(const ECSharedLog& other)
+    {
+        if (this != &other)
+        {
+            chunks = other.chunks;
+            numItems = other.numItems;
+            OwnLastChunk();
+        }
+        return *this;
+    }
+    ECSharedLog(ECSharedLog&&) = default; //the moved-from log is left with nothing to share
+    ECSharedLog& operator=(ECSharedLog&&) = default;
+
+    size_t size() const { return numItems; }
+    bool empty() const { return numItems == 0; }
+
+    const T& operator[](size_t i) const { return (*chunks[i >> ChunkBits])[i & Mask]; }
+    const T& back() const { return chunks.back()->back(); }
+    T& MutableBack() { return chunks.back()->back(); } //last item, for updating in place
+
+    void push_back(const T& item)
+    {
+        if ((numItems & Mask) == 0) //last chunk full (or none yet)
+        {
+            chunks.push_back(std::make_shared<std::vector<T>>());
+            chunks.back()->reserve(ChunkSize);
+        }
+        chunks.back()->push_back(item);
+        numItems++;
+    }
+
+    void clear()
+    {
+        chunks.clear();
+        numItems = 0;
+    }
+
+    //checkpoints: same layout as ECSnapshotWriter::PutVector (length, then the items)
+    void Save(ECSnapshotWriter& out) const
+    {
+        out.Put((uint64_t)numItems);
+        for (auto& chunk : chunks)
+        {
+            out.WriteBytes(chunk->data(), chunk->size() * sizeof(T));
+        }
+    }
+    void Load(ECSnapshotReader& in)
+    {
+        std::vector<T> items;
+        in.GetVector(items);
+        clear();
+        for (const T& item : items)
+        {
+            push_back(item);
+        }
+    }
+
+private:
+    static const size_t ChunkSize = (size_t)1 << ChunkBits;
+    static const size_t Mask = ChunkSize - 1;
+
+    void OwnLastChunk() //after copying the pointers: replace the last chunk with our own copy
+    {
+        if (chunks.empty()) { return; }
+        std::shared_ptr<std::vector<T>>& last = chunks.back();
+        auto copy = std::make_shared<std::vector<T>>();
+        copy->reserve(ChunkSize);
+        copy->assign(last->begin(), last->end());
+        last = copy;
+    }
+
+    std::vector<std::shared_ptr<std::vector<T>>> chunks;
+    size_t numItems = 0;
+};
+
+#endif /* ECSharedLog_h */
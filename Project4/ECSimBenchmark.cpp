@@ -0,0 +1,481 @@
+//
+//  ECSimBenchmark.cpp
+//
+
+#include "ECSimBenchmark.h"
+#include "ECFloorKernels.h"
+#include "ECElevatorTrace.h"
+#include "ECElevatorSim.h"
+#include "ECAllocStats.h"
+#include "ECElevatorLiveSource.h"
+#include "ECScenarioRunner.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+static volatile long long benchSink = 0; //keeps the timed calls from being optimized away
+
+//average ns per closest-floor query, asked from every floor in turn so neither side can settle into one answer
+template <class Query>
+static double TimeClosest(const Query& query, int numFloors, int reps)
+{
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++)
+    {
+        benchSink = benchSink + query(1 + r % numFloors);
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / reps;
+}
+
+void ECSimBenchmark::RunKernels(ostream& out)
+{
+    const int numFloors = 100;
+    const int sizes[] = {8, 16, 32, 64, 1000, 100000, 1000000};
+    EC_SIMD_LEVEL prevLevel = ECFloorKernels::GetLevel();
+    EC_SIMD_LEVEL bestLevel = ECFloorKernels::GetBestLevel();
+
+    out << "closest requested floor: demand index vs scan of the car's activeFloors, best level: " << ECFloorKernels::GetLevelName(bestLevel) << endl;
+    out << setw(10) << "requests" << setw(10) << "method" << setw(16) << "ns/call" << setw(12) << "vs index" << endl;
+
+    mt19937 rng(12345);
+    uniform_int_distribution<int> pick(1, numFloors);
+    for (int size : sizes)
+    {
+        //the same requests both ways, in request order: waiting ones by their floor, riders by their destination
+        ECElevatorDemandIndex demand(numFloors);
+        vector<int> floors(size);
+        for (int id = 0; id < size; id++)
+        {
+            int floorSrc = pick(rng), floorDest = pick(rng);
+            if (id % 2) { floors[id] = floorSrc; demand.AddHallCall(floorSrc, floorDest > floorSrc, id); }
+            else { floors[id] = floorDest; demand.AddCarCall(floorDest, id); }
+        }
+        int reps = size >= 1000000 ? 20 : (size >= 100000 ? 200 : (size >= 1000 ? 20000 : 1000000));
+
+        auto byIndex = [&](int floor) { return demand.FindClosest(floor); };
+        auto byScan = [&](int floor) { return ECFloorKernels::FindClosest(floors.data(), size, floor, 1, numFloors); };
+        TimeClosest(byIndex, numFloors, reps / 10 + 1); //warm up
+        double indexNs = TimeClosest(byIndex, numFloors, reps);
+        out << setw(10) << size << setw(10) << "index" << setw(16) << fixed << setprecision(1) << indexNs << setw(11) << setprecision(2) << 1.0 << "x" << endl;
+        for (int lvl = EC_SIMD_SCALAR; lvl <= bestLevel; lvl++)
+        {
+            ECFloorKernels::SetLevel((EC_SIMD_LEVEL)lvl);
+            TimeClosest(byScan, numFloors, reps / 10 + 1);
+            double ns = TimeClosest(byScan, numFloors, reps);
+            out << setw(10) << size << setw(10) << ECFloorKernels::GetLevelName((EC_SIMD_LEVEL)lvl) << setw(16) << setprecision(1) << ns
+                << setw(11) << setprecision(2) << indexNs / ns << "x" << endl;
+        }
+    }
+    ECFloorKernels::SetLevel(prevLevel);
+}
+
+//the loop main.cpp used before ECElevatorTraceLoader
+static size_t ParseWithStreams(const string& filename)
+{
+    ifstream inFile(filename);
+    int numFloors = 0, lenSim = 0;
+    string line;
+    while (getline(inFile, line))
+    {
+        if (line.empty() || line[0] == '#') { continue; }
+        istringstream iss(line);
+        iss >> numFloors >> lenSim;
+        break;
+    }
+    vector<ECElevatorSimRequest> requests;
+    while (getline(inFile, line))
+    {
+        if (line.empty() || line[0] == '#') { continue; }
+        istringstream iss(line);
+        int t, src, dest;
+        if (iss >> t >> src >> dest) { requests.push_back(ECElevatorSimRequest(t, src, dest)); }
+    }
+    return requests.size();
+}
+
+void ECSimBenchmark::RunParser(ostream& out, int numLines)
+{
+    const int numFloors = 50;
+    string filename = "ec_bench_trace.txt";
+    {
+        ofstream file(filename);
+        mt19937 rng(12345);
+        uniform_int_distribution<int> pick(1, numFloors);
+        file << "# benchmark trace\n" << numFloors << " " << numLines << "\n";
+        for (int i = 0; i < numLines; i++)
+        {
+            int src = pick(rng), dest = pick(rng);
+            if (dest == src) { dest = src % numFloors + 1; }
+            file << i << " " << src << " " << dest << "\n";
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    size_t numOld = ParseWithStreams(filename);
+    auto mid = chrono::steady_clock::now();
+    ECElevatorTraceLoader loader;
+    loader.Load(filename);
+    size_t numNew = loader.GetRequests().size();
+    auto end = chrono::steady_clock::now();
+
+    //same trace as a binary file: opening maps it, reading the records is what a run would do
+    string binFilename = "ec_bench_trace.ectrace";
+    ECElevatorBinaryTrace::Write(binFilename, loader.GetNumFloors(), loader.GetLenSim(), loader.GetRequests());
+    auto binStart = chrono::steady_clock::now();
+    double binOpenMs = 0;
+    size_t numBin = 0;
+    {
+        ECElevatorBinaryTrace trace;
+        trace.Open(binFilename);
+        binOpenMs = chrono::duration<double, milli>(chrono::steady_clock::now() - binStart).count();
+        ECElevatorBinarySource source(trace);
+        ECElevatorSimRequest req(0, 0, 0);
+        while (source.Next(req)) { numBin++; }
+    }
+    auto binEnd = chrono::steady_clock::now();
+    remove(filename.c_str());
+    remove(binFilename.c_str());
+
+    double oldMs = chrono::duration<double, milli>(mid - start).count();
+    double newMs = chrono::duration<double, milli>(end - mid).count();
+    out << "trace parsing, " << numLines << " lines" << endl;
+    out << setw(24) << "getline/istringstream" << setw(12) << fixed << setprecision(1) << oldMs << " ms" << setw(12) << numOld << " requests" << endl;
+    out << setw(24) << "mmap/from_chars" << setw(12) << newMs << " ms" << setw(12) << numNew << " requests" << endl;
+    out << setw(24) << "speedup" << setw(12) << setprecision(2) << oldMs / newMs << "x" << endl;
+    out << setw(24) << "binary open" << setw(12) << setprecision(3) << binOpenMs << " ms" << endl;
+    out << setw(24) << "binary open + read all" << setw(12) << setprecision(1) << chrono::duration<double, milli>(binEnd - binStart).count() << " ms" << setw(12) << numBin << " requests" << endl;
+}
+
+//*****************************************************************************
+// Simulation core suite
+
+namespace
+{
+    struct BenchResult
+    {
+        string name;
+        int numFloors;
+        int numRequests;
+        int lenSim;
+        const char* unit; //what one op is: "tick" or "call"
+        double nsPerOp;
+        double allocsPerOp;
+        long long peakBytes; //heap in use at the peak, above what was in use before the case
+    };
+
+    //times fn() (which does numOps ops) and records heap use while it runs
+    template <class Fn>
+    BenchResult Measure(const string& name, int numFloors, int numRequests, int lenSim, const char* unit, long long numOps, Fn fn)
+    {
+        long long bytesBefore = ECAllocStats::GetBytesInUse();
+        ECAllocStats::ResetPeak();
+        long long allocsBefore = ECAllocStats::GetNumAllocs();
+        auto start = chrono::steady_clock::now();
+        fn();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        long long allocs = ECAllocStats::GetNumAllocs() - allocsBefore;
+        numOps = max(numOps, 1LL);
+        return BenchResult{ name, numFloors, numRequests, lenSim, unit, ns / numOps, (double)allocs / numOps, ECAllocStats::GetPeakBytes() - bytesBefore };
+    }
+
+    //numRequests requests between random floors, made at random times in [0, tmLast]
+    vector<ECElevatorSimRequest> MakeRequests(int numFloors, int numRequests, int tmLast, unsigned seed)
+    {
+        mt19937 rng(seed);
+        uniform_int_distribution<int> pickFloor(1, numFloors), pickTime(0, tmLast);
+        vector<ECElevatorSimRequest> requests;
+        requests.reserve(numRequests);
+        for (int i = 0; i < numRequests; i++)
+        {
+            int src = pickFloor(rng), dest = pickFloor(rng);
+            if (dest == src) { dest = src % numFloors + 1; }
+            requests.push_back(ECElevatorSimRequest(pickTime(rng), src, dest));
+        }
+        stable_sort(requests.begin(), requests.end(), [](const ECElevatorSimRequest& a, const ECElevatorSimRequest& b) { return a.GetTime() < b.GetTime(); });
+        return requests;
+    }
+
+    BenchResult TimeSimulate(bool eventDriven, int numFloors, int numRequests, int lenSim, int tmLast)
+    {
+        vector<ECElevatorSimRequest> requests = MakeRequests(numFloors, numRequests, tmLast, 12345);
+        return Measure(eventDriven ? "SimulateEventDriven" : "Simulate", numFloors, numRequests, lenSim, "tick", lenSim, [&] {
+            ECElevatorSim sim(numFloors, requests);
+            if (eventDriven) { sim.SimulateEventDriven(lenSim); }
+            else { sim.Simulate(lenSim); }
+        });
+    }
+}
+
+void ECSimBenchmark::RunSuite(ostream& out, bool quick, bool json)
+{
+    vector<BenchResult> results;
+    const int floorCounts[] = { 10, 100, 500 };
+    const int requestCounts[] = { 10, 1000, 100000, 1000000 };
+
+    //whole simulation, every request in flight from time 0
+    for (int eventDriven = 0; eventDriven <= 1; eventDriven++)
+    {
+        for (int numFloors : floorCounts)
+        {
+            for (int numRequests : requestCounts)
+            {
+                if (quick && numRequests > 100000) { continue; }
+                results.push_back(TimeSimulate(eventDriven != 0, numFloors, numRequests, 2000, 0));
+            }
+        }
+    }
+
+    //longer and longer runs at a steady load (a request every 10 ticks on average)
+    for (int eventDriven = 0; eventDriven <= 1; eventDriven++)
+    {
+        for (int lenSim = 1000; lenSim <= (quick ? 100000 : 1000000); lenSim *= 10)
+        {
+            results.push_back(TimeSimulate(eventDriven != 0, 100, lenSim / 10, lenSim, lenSim - 1));
+        }
+    }
+
+    //the same load fed in as it happens, one Step per tick: the cost per step should not grow with the run
+    for (int lenSim = 1000; lenSim <= (quick ? 100000 : 1000000); lenSim *= 10)
+    {
+        vector<ECElevatorSimRequest> requests = MakeRequests(100, lenSim / 10, lenSim - 1, 12345);
+        results.push_back(Measure("Step (live feed)", 100, lenSim / 10, lenSim, "tick", lenSim, [&] {
+            vector<ECElevatorSimRequest> live;
+            ECElevatorVectorSource source(live);
+            ECElevatorSim sim(100, source);
+            size_t next = 0;
+            for (int tm = 0; tm < lenSim; tm++)
+            {
+                for (; next < requests.size() && requests[next].GetTime() <= tm; next++) { live.push_back(requests[next]); }
+                sim.Step();
+            }
+        }));
+    }
+
+    //direction policies, each with the loop built for it (calls inlined) and through the virtual interface
+    for (EC_DIRECTION_POLICY type : { EC_POLICY_CLASSIC, EC_POLICY_NEAREST, EC_POLICY_LOOK, EC_POLICY_SCAN })
+    {
+        const int numFloors = 100, lenSim = 100000, numRequests = 10000;
+        vector<ECElevatorSimRequest> requests = MakeRequests(numFloors, numRequests, lenSim - 1, 4242);
+        const ECElevatorDirectionPolicy& policy = ECElevatorDirectionPolicy::ForType(type);
+        for (int useVirtual = 0; useVirtual <= 1; useVirtual++)
+        {
+            string name = string("Simulate ") + ECElevatorDirectionPolicy::GetName(type) + (useVirtual ? " (virtual)" : "");
+            vector<ECElevatorSimRequest> run = requests; //the simulator writes status back into the list
+            results.push_back(Measure(name, numFloors, numRequests, lenSim, "tick", lenSim, [&] {
+                ECElevatorSim sim(numFloors, run);
+                if (useVirtual) { sim.Simulate(lenSim, policy); } //base class reference: virtual calls every tick
+                else { sim.SetDirectionPolicy(type); sim.Simulate(lenSim); }
+            }));
+        }
+    }
+
+    //history: recording one tick (RecordState), with a passenger arriving, boarding and leaving every 10 ticks,
+    //then playing it back tick by tick
+    {
+        const int numTicks = quick ? 100000 : 1000000;
+        ECElevatorHistory history;
+        results.push_back(Measure("RecordState", 100, numTicks / 10, numTicks, "tick", numTicks, [&] {
+            for (int tm = 0; tm < numTicks; tm++)
+            {
+                if (tm % 10 == 0) { history.RecordArrival(tm / 10, 1 + tm % 100, 1 + (tm + 50) % 100); }
+                if (tm % 10 == 3) { history.RecordBoarding(tm / 10, 1 + (tm - 3) % 100, 1 + (tm + 47) % 100); }
+                if (tm % 10 == 7) { history.RecordAlighting(tm / 10, 1 + (tm - 7) % 100, 1 + (tm + 43) % 100); }
+                history.RecordTick(tm, 1 + (tm / 3) % 100, tm % 3 ? EC_ELEVATOR_UP : EC_ELEVATOR_STOPPED);
+            }
+        }));
+        results.push_back(Measure("GetState", 100, numTicks / 10, numTicks, "tick", numTicks, [&] {
+            for (int tm = 0; tm < numTicks; tm++)
+            {
+                benchSink = benchSink + history.GetState(tm).floor;
+            }
+        }));
+    }
+
+    //direction helpers with every request waiting: anyDirReqs both ways, anyFloorReq and handleDirectionChange (nearest floor)
+    for (int numFloors : floorCounts)
+    {
+        for (int numRequests : requestCounts)
+        {
+            if (quick && numRequests > 100000) { continue; }
+            vector<ECElevatorSimRequest> requests = MakeRequests(numFloors, numRequests, 0, 777);
+            ECElevatorSim sim(numFloors, requests);
+            sim.Simulate(1); //makes every request
+            const int numCalls = 1000000;
+            results.push_back(Measure("direction helpers", numFloors, numRequests, 0, "call", numCalls, [&] {
+                for (int i = 0; i < numCalls / 4; i++)
+                {
+                    sim.SetCurrFloor(1 + i % numFloors);
+                    long long res = sim.anyDirReqs(EC_ELEVATOR_UP) + sim.anyDirReqs(EC_ELEVATOR_DOWN) + sim.anyFloorReq(sim.GetCurrFloor());
+                    sim.handleDirectionChange();
+                    benchSink = benchSink + res + sim.GetCurrDir();
+                }
+            }));
+        }
+    }
+
+    if (json)
+    {
+        out << "{\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult& res = results[i];
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << res.name << "\", \"floors\": " << res.numFloors << ", \"requests\": " << res.numRequests
+                << ", \"lenSim\": " << res.lenSim << ", \"unit\": \"" << res.unit << "\", \"nsPerOp\": " << res.nsPerOp
+                << ", \"allocsPerOp\": " << res.allocsPerOp << ", \"peakBytes\": " << res.peakBytes << "}";
+        }
+        out << "\n  ]\n}" << endl;
+        return;
+    }
+
+    out << left << setw(28) << "case" << right << setw(8) << "floors" << setw(10) << "requests" << setw(10) << "lenSim"
+        << setw(14) << "ns/op" << setw(6) << "op" << setw(12) << "allocs/op" << setw(14) << "peak bytes" << endl;
+    for (auto& res : results)
+    {
+        out << left << setw(28) << res.name << right << setw(8) << res.numFloors << setw(10) << res.numRequests << setw(10) << res.lenSim
+            << setw(14) << fixed << setprecision(1) << res.nsPerOp << setw(6) << res.unit << setw(12) << setprecision(3) << res.allocsPerOp
+            << setw(14) << res.peakBytes << endl;
+    }
+}
+
+//*****************************************************************************
+// Live request feed
+
+namespace
+{
+    //numProducers threads push numCalls calls between them as fast as they can (retrying when the queue is full)
+    //while this thread collects and reads them; returns ns per call
+    double TimeLiveQueue(int numProducers, bool multiProducer, long long numCalls, long long& numFull)
+    {
+        ECElevatorLiveSource live(4096, multiProducer);
+        auto start = chrono::steady_clock::now();
+        vector<thread> producers;
+        for (int p = 0; p < numProducers; p++)
+        {
+            producers.emplace_back([&live, p, numProducers, numCalls] {
+                for (long long i = p; i < numCalls; i += numProducers)
+                {
+                    while (!live.Push(1 + (int)(i % 50), 1 + (int)((i + 25) % 50))) { this_thread::yield(); }
+                }
+            });
+        }
+        ECElevatorSimRequest req(0, 0, 0);
+        for (long long numRead = 0; numRead < numCalls; )
+        {
+            live.Collect(0);
+            while (live.Next(req)) { numRead++; }
+        }
+        for (auto& producer : producers) { producer.join(); }
+        numFull = live.GetNumDropped();
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / numCalls;
+    }
+}
+
+void ECSimBenchmark::RunLive(ostream& out, int numProducers)
+{
+    numProducers = max(numProducers, 1);
+    const long long numCalls = 4000000;
+    out << "live queue, " << numCalls << " calls pushed flat out and read back" << endl;
+    out << setw(24) << "queue" << setw(12) << "ns/call" << setw(14) << "full retries" << endl;
+    for (int p = 0; p <= numProducers; p++)
+    {
+        bool multiProducer = p > 0;
+        int n = max(p, 1);
+        if (multiProducer && p > 1 && p < numProducers && (p & (p - 1)) != 0) { continue; } //1, 2, 4, ... and the max
+        long long numFull = 0;
+        double ns = TimeLiveQueue(n, multiProducer, numCalls, numFull);
+        string name = string(multiProducer ? "mpsc, " : "spsc, ") + to_string(n) + (n == 1 ? " producer" : " producers");
+        out << setw(24) << name << setw(12) << fixed << setprecision(1) << ns << setw(14) << numFull << endl;
+    }
+
+    //a bank of cars stepped tick by tick as fast as it goes while producers push a call every 20us each
+    const int numFloors = 100, numCars = 8, lenSim = 500000;
+    ECElevatorLiveSource live(4096, true);
+    ECElevatorSim sim(numFloors, numCars, live);
+    sim.SetRecordHistory(false);
+    atomic<bool> done{ false };
+    vector<thread> producers;
+    for (int p = 0; p < numProducers; p++)
+    {
+        producers.emplace_back([&live, &done, p, numFloors] {
+            mt19937 rng(1000 + p);
+            uniform_int_distribution<int> pickFloor(1, numFloors);
+            auto due = chrono::steady_clock::now();
+            while (!done.load(memory_order_relaxed))
+            {
+                due += chrono::microseconds(20);
+                while (chrono::steady_clock::now() < due) { this_thread::yield(); }
+                int src = pickFloor(rng), dest = pickFloor(rng);
+                live.Push(src, dest == src ? src % numFloors + 1 : dest);
+            }
+        });
+    }
+    auto start = chrono::steady_clock::now();
+    for (int tm = 0; tm < lenSim; tm++)
+    {
+        live.Collect(tm);
+        sim.Step();
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    done = true;
+    for (auto& producer : producers) { producer.join(); }
+
+    const ECLatencyHistogram& latency = live.GetLatency();
+    out << endl << "live simulation, " << numFloors << " floors, " << numCars << " cars, " << numProducers << (numProducers == 1 ? " producer" : " producers") << endl;
+    out << setw(24) << "ticks/s" << setw(12) << setprecision(0) << lenSim / ms * 1000 << endl;
+    out << setw(24) << "calls dispatched" << setw(12) << latency.GetCount() << endl;
+    out << setw(24) << "calls dropped (full)" << setw(12) << live.GetNumDropped() << endl;
+    out << setw(24) << "push->dispatch us" << setw(12) << "p50" << setw(10) << "p90" << setw(10) << "p99" << setw(10) << "max" << endl;
+    out << setw(24) << "" << setprecision(2) << setw(12) << latency.GetPercentile(50) / 1000.0 << setw(10) << latency.GetPercentile(90) / 1000.0
+        << setw(10) << latency.GetPercentile(99) / 1000.0 << setw(10) << latency.GetMax() / 1000.0 << endl;
+}
+
+void ECSimBenchmark::RunBatch(ostream& out, int maxThreads)
+{
+    int numCores = max(1, (int)thread::hardware_concurrency());
+    if (maxThreads <= 0) { maxThreads = numCores; }
+
+    //generated traffic, so nothing is read from disk and every scenario does about the same work
+    const int numScenarios = 32;
+    const EC_DIRECTION_POLICY policies[] = { EC_POLICY_CLASSIC, EC_POLICY_NEAREST, EC_POLICY_LOOK, EC_POLICY_SCAN };
+    vector<ECScenario> scenarios;
+    for (int i = 0; i < numScenarios; i++)
+    {
+        ECScenario scenario;
+        scenario.traceFile = "gen:up-peak:floors=30:len=20000:rate=2:seed=" + to_string(i + 1);
+        scenario.numCars = 4;
+        scenario.policy = policies[i % 4];
+        scenarios.push_back(scenario);
+    }
+
+    out << "batch runs, " << numScenarios << " scenarios (" << scenarios[0].traceFile << ", 4 cars, each policy), "
+        << "hardware threads: " << numCores << endl;
+    out << setw(10) << "threads" << setw(14) << "total ms" << setw(16) << "scenarios/s" << setw(10) << "speedup" << endl;
+
+    double oneThreadMs = 0;
+    long long serviced1 = -1;
+    for (int n = 1; n <= maxThreads; n = (n < maxThreads && n * 2 > maxThreads) ? maxThreads : n * 2) //1, 2, 4, ... and the max
+    {
+        ECScenarioRunner runner(n);
+        for (const ECScenario& scenario : scenarios) { runner.Add(scenario); }
+        auto start = chrono::steady_clock::now();
+        const vector<ECScenarioResult>& results = runner.Run();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        long long serviced = 0;
+        for (const ECScenarioResult& res : results) { serviced += res.numServiced; }
+        if (n == 1) { oneThreadMs = ms; serviced1 = serviced; }
+        out << setw(10) << n << setw(14) << fixed << setprecision(1) << ms << setw(16) << numScenarios * 1000.0 / ms
+            << setw(9) << setprecision(2) << oneThreadMs / ms << "x" << (serviced != serviced1 ? "  (results differ from 1 thread!)" : "") << endl;
+        if (n == maxThreads) { break; }
+    }
+}
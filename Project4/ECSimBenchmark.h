@@ -0,0 +1,42 @@
+//
+//  ECSimBenchmark.h
+//
+
+#ifndef ECSimBenchmark_h
+#define ECSimBenchmark_h
+
+#include <iostream>
+
+//*****************************************************************************
+// Micro benchmarks for the simulator's hot paths
+// Run from the benchmark program (ECSimBenchmarkMain.cpp, the Project4Bench target); results are printed as a plain table
+
+class ECSimBenchmark
+{
+public:
+    // Closest requested floor (what the policies ask when stopped) from the demand index and from a scan
+    // of the car's activeFloors with ECFloorKernels at every SIMD level the CPU supports, over 8 to 1M
+    // active requests; prints ns per call and speedup over the index
+    static void RunKernels(std::ostream& out);
+
+    // Write a trace with numLines requests to a temp file, then time loading it with
+    // getline/istringstream (the old main.cpp loop), with ECElevatorTraceLoader and as a binary trace
+    static void RunParser(std::ostream& out, int numLines);
+
+    // Simulation core suite: Simulate/SimulateEventDriven sweeping numFloors, active requests and
+    // lenSim, history recording (RecordTick) and playback (GetState), and the direction helpers.
+    // Each case reports ns per tick (or call), heap allocations per tick (or call) and peak heap bytes.
+    // quick: skip the 1M-request cases; json: machine-readable output instead of a table
+    static void RunSuite(std::ostream& out, bool quick, bool json);
+
+    // Live feed (ECElevatorLiveSource): queue throughput with one producer (single-producer ring) and
+    // 1, 2, 4, ... numProducers producers (multi-producer ring), then a bank of cars stepped tick by tick
+    // while numProducers threads push calls, with the latency from push to dispatch
+    static void RunLive(std::ostream& out, int numProducers);
+
+    // Batch runs (ECScenarioRunner): the same set of generated scenarios on 1, 2, 4, ... maxThreads
+    // pool threads (0: one per hardware thread), with wall time and speedup over one thread
+    static void RunBatch(std::ostream& out, int maxThreads);
+};
+
+#endif /* ECSimBenchmark_h */
@@ -0,0 +1,51 @@
+#include "ECSimBenchmark.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+//benchmark program (the Project4Bench target); kept out of the simulator itself because it links
+//ECAllocStats, which replaces the global operator new/delete to count heap use
+//(no arguments) [--quick] [--json]: simulation core suite
+//--live [producers]: live request queue with that many producer threads
+//--parse [lines]: trace loading with a trace of that many lines
+//--kernels: closest requested floor, demand index vs SIMD scan
+//--batch [threads]: batch runs on 1, 2, 4, ... that many pool threads (default: one per hardware thread)
+int main(int argc, char *argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "--live")
+    {
+        ECSimBenchmark::RunLive(std::cout, argc > 2 ? std::atoi(argv[2]) : 4);
+        return 0;
+    }
+    if (mode == "--batch")
+    {
+        ECSimBenchmark::RunBatch(std::cout, argc > 2 ? std::atoi(argv[2]) : 0);
+        return 0;
+    }
+    if (mode == "--kernels")
+    {
+        ECSimBenchmark::RunKernels(std::cout);
+        return 0;
+    }
+    if (mode == "--parse")
+    {
+        ECSimBenchmark::RunParser(std::cout, argc > 2 ? std::atoi(argv[2]) : 10000000);
+        return 0;
+    }
+
+    bool quick = false, json = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--quick") { quick = true; }
+        else if (arg == "--json") { json = true; }
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--quick] [--json] | --live [producers] | --parse [lines] | --kernels | --batch [threads]" << std::endl;
+            return 1;
+        }
+    }
+    ECSimBenchmark::RunSuite(std::cout, quick, json);
+    return 0;
+}
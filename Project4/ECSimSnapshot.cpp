@@ -0,0 +1,15 @@
+//
+//  ECSimSnapshot.cpp
+//
+
+#include "ECSimSnapshot.h"
+
+using namespace std;
+
+bool ECSnapshotReader::ReadBytes(void* data, size_t size)
+{
+    if (!ok) { return false; }
+    in.read((char*)data, (streamsize)size);
+    if ((size_t)in.gcount() != size) { ok = false; }
+    return ok;
+}
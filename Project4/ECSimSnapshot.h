@@ -0,0 +1,85 @@
+//
+//  ECSimSnapshot.h
+//
+
+#ifndef ECSimSnapshot_h
+#define ECSimSnapshot_h
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//*****************************************************************************
+// Raw binary writer/reader behind simulator checkpoints
+// Values and arrays of plain structs go out as their bytes in memory (native byte order, like
+// binary traces); arrays are prefixed with their length. The reader never throws: after the
+// first short read or an array longer than the limit it returns zeros and IsOk() turns false
+
+class ECSnapshotWriter
+{
+public:
+    ECSnapshotWriter(std::ostream& out) : out(out) {}
+
+    void WriteBytes(const void* data, size_t size) { out.write((const char*)data, (std::streamsize)size); }
+
+    template <class T> void Put(const T& value) { WriteBytes(&value, sizeof(T)); }
+    template <class T> void PutVector(const std::vector<T>& vec)
+    {
+        Put((uint64_t)vec.size());
+        if (!vec.empty()) { WriteBytes(vec.data(), vec.size() * sizeof(T)); }
+    }
+
+    bool IsOk() const { return (bool)out; }
+
+private:
+    std::ostream& out;
+};
+
+class ECSnapshotReader
+{
+public:
+    ECSnapshotReader(std::istream& in) : in(in) {}
+
+    bool ReadBytes(void* data, size_t size);
+
+    template <class T> T Get()
+    {
+        T value{};
+        if (!ReadBytes(&value, sizeof(T))) { value = T{}; }
+        return value;
+    }
+    template <class T> void GetVector(std::vector<T>& vec, uint64_t maxSize = MaxVectorSize)
+    {
+        uint64_t size = Get<uint64_t>();
+        if (!ok || size > maxSize) { Fail(); size = 0; }
+        vec.clear();
+        //grow a chunk at a time as the bytes actually arrive, so a corrupt length runs into the end
+        //of the stream after at most one chunk instead of asking for gigabytes up front
+        const size_t chunkItems = std::max((size_t)1, ChunkBytes / sizeof(T));
+        while (vec.size() < size)
+        {
+            size_t start = vec.size();
+            size_t num = (size_t)std::min((uint64_t)chunkItems, size - start);
+            vec.resize(start + num);
+            if (!ReadBytes(vec.data() + start, num * sizeof(T)))
+            {
+                vec.clear();
+                return;
+            }
+        }
+    }
+
+    void Fail() { ok = false; } //also for callers that find the data doesn't make sense
+    bool IsOk() const { return ok; }
+
+    static const uint64_t MaxVectorSize = 1ULL << 32; //sanity limit on array lengths
+    static const size_t ChunkBytes = (size_t)1 << 20; //GetVector reads (and grows) this much at a time
+
+private:
+    std::istream& in;
+    bool ok = true;
+};
+
+#endif /* ECSimSnapshot_h */
@@ -0,0 +1,106 @@
+//
+//  ECThreadPool.cpp
+//
+
+#include "ECThreadPool.h"
+
+using namespace std;
+
+ECThreadPool::ECThreadPool(int numThreads)
+{
+    if (numThreads <= 0) { numThreads = max(1, (int)thread::hardware_concurrency()); }
+    for (int i = 0; i < numThreads; i++)
+    {
+        queues.emplace_back(new WorkerQueue());
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers.emplace_back(&ECThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ECThreadPool::~ECThreadPool()
+{
+    WaitIdle();
+    {
+        lock_guard<mutex> guard(stateLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ECThreadPool::Submit(std::function<void()> task)
+{
+    int q = (int)(nextQueue.fetch_add(1, memory_order_relaxed) % queues.size());
+    numPending++; //before the task can run (and finish)
+    {
+        lock_guard<mutex> guard(queues[q]->lock);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    numQueued++; //after the push, so a worker that sees the count finds the task
+    if (numSleeping > 0)
+    {
+        { lock_guard<mutex> guard(stateLock); } //a worker between checking numQueued and waiting can't miss the wakeup
+        workAvailable.notify_one();
+    }
+}
+
+void ECThreadPool::WaitIdle()
+{
+    unique_lock<mutex> guard(stateLock);
+    allDone.wait(guard, [this] { return numPending == 0; });
+}
+
+bool ECThreadPool::TryTake(int self, std::function<void()>& task)
+{
+    int n = (int)queues.size();
+    for (int k = 0; k < n; k++)
+    {
+        WorkerQueue& queue = *queues[(self + k) % n];
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.tasks.empty()) { continue; }
+        if (k == 0) //own queue: newest first
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else //steal the oldest
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ECThreadPool::WorkerLoop(int self)
+{
+    while (true)
+    {
+        std::function<void()> task;
+        if (!TryTake(self, task))
+        {
+            //nothing anywhere: sleep until a submit (numSleeping and numQueued are both seq_cst, so
+            //either Submit sees this worker asleep or the worker sees the new task)
+            unique_lock<mutex> guard(stateLock);
+            numSleeping++;
+            workAvailable.wait(guard, [this] { return stopping || numQueued > 0; });
+            numSleeping--;
+            if (stopping && numQueued == 0) { return; } //nothing left
+            continue;
+        }
+        numQueued--;
+        task();
+
+        if (--numPending == 0)
+        {
+            lock_guard<mutex> guard(stateLock); //so WaitIdle can't miss it between its check and its wait
+            allDone.notify_all();
+        }
+    }
+}
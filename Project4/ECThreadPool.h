@@ -0,0 +1,61 @@
+//
+//  ECThreadPool.h
+//
+
+#ifndef ECThreadPool_h
+#define ECThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//*****************************************************************************
+// Work-stealing thread pool
+// Each worker has its own task deque: it takes work from the back of its own deque and, when
+// that runs dry, steals from the front of the others'. Submitted tasks are spread round-robin,
+// so long and short tasks even out without a single shared queue everyone contends on. The task
+// counts are atomics; the pool lock is only taken to go to sleep and to wake sleepers up
+
+class ECThreadPool
+{
+public:
+    ECThreadPool(int numThreads = 0); //0: one per hardware thread
+    ~ECThreadPool(); //waits for queued tasks, then joins
+    ECThreadPool(const ECThreadPool&) = delete;
+    ECThreadPool& operator=(const ECThreadPool&) = delete;
+
+    int GetNumThreads() const { return (int)workers.size(); }
+
+    void Submit(std::function<void()> task);
+    void WaitIdle(); //until every submitted task has finished
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void WorkerLoop(int self);
+    bool TryTake(int self, std::function<void()>& task); //own queue first, then steal
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue{ 0 };
+
+    std::atomic<int> numQueued{ 0 }; //in a queue, not taken yet (counted after the push)
+    std::atomic<int> numPending{ 0 }; //submitted, not finished yet (counted before the push)
+    std::atomic<int> numSleeping{ 0 }; //workers waiting on workAvailable; Submit only locks to wake them
+    std::atomic<bool> stopping{ false };
+
+    std::mutex stateLock; //only for sleeping: workers wait on workAvailable, WaitIdle on allDone
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+};
+
+#endif /* ECThreadPool_h */
@@ -0,0 +1,221 @@
+//
+//  ECTrafficGenerator.cpp
+//
+
+#include "ECTrafficGenerator.h"
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <cstdlib>
+
+using namespace std;
+
+ECTrafficGenerator::ECTrafficGenerator(const ECTrafficConfig& config) : config(config), state(config.seed), time(0)
+{
+    BuildAliasTable();
+}
+
+uint64_t ECTrafficGenerator::NextRandom()
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double ECTrafficGenerator::NextUniform()
+{
+    return (NextRandom() >> 11) * (1.0 / 9007199254740992.0); //top 53 bits
+}
+
+//Vose's alias method over the floors PickFloor may return (positive weight; not the lobby unless uniform)
+void ECTrafficGenerator::BuildAliasTable()
+{
+    vector<double> weights;
+    for (int f = 1; f <= config.numFloors; f++)
+    {
+        if (f == config.lobby && config.pattern != EC_TRAFFIC_UNIFORM) { continue; } //lobby trips are decided by the pattern
+        double w = f - 1 < (int)config.floorWeights.size() ? config.floorWeights[f - 1] : 1.0;
+        if (w > 0)
+        {
+            floors.push_back(f);
+            weights.push_back(w);
+        }
+    }
+
+    int n = (int)floors.size();
+    double total = 0;
+    for (double w : weights) { total += w; }
+    aliasProb.assign(n, 1.0);
+    alias.assign(n, 0);
+    vector<int> small, large;
+    vector<double> scaled(n);
+    for (int i = 0; i < n; i++)
+    {
+        scaled[i] = weights[i] * n / total;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty())
+    {
+        int s = small.back(), l = large.back();
+        small.pop_back();
+        aliasProb[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+}
+
+int ECTrafficGenerator::PickFloor()
+{
+    int i = (int)(NextUniform() * floors.size());
+    return NextUniform() < aliasProb[i] ? floors[i] : floors[alias[i]];
+}
+
+int ECTrafficGenerator::PickOtherFloor(int floor)
+{
+    for (int tries = 0; tries < 16; tries++)
+    {
+        int f = PickFloor();
+        if (f != floor) { return f; }
+    }
+    for (int f : floors) //floor takes nearly all the weight: take any other one
+    {
+        if (f != floor) { return f; }
+    }
+    return floor;
+}
+
+bool ECTrafficGenerator::Next(ECElevatorSimRequest& req)
+{
+    if (floors.empty() || config.arrivalRate <= 0) { return false; } //nowhere to go
+
+    time += -log(1.0 - NextUniform()) / config.arrivalRate; //exponential gap between arrivals
+    if (time >= config.lenSim) { return false; }
+
+    int src, dest;
+    double u = NextUniform();
+    bool interfloor = u >= config.lobbyShare || config.pattern == EC_TRAFFIC_UNIFORM || floors.size() < 2;
+    if (!interfloor && config.pattern == EC_TRAFFIC_LUNCH) //half of the lobby trips each way
+    {
+        if (u < config.lobbyShare / 2) { src = config.lobby; dest = PickFloor(); }
+        else { src = PickFloor(); dest = config.lobby; }
+    }
+    else if (!interfloor && config.pattern == EC_TRAFFIC_UP_PEAK) { src = config.lobby; dest = PickFloor(); }
+    else if (!interfloor && config.pattern == EC_TRAFFIC_DOWN_PEAK) { src = PickFloor(); dest = config.lobby; }
+    else if (floors.size() >= 2)
+    {
+        src = PickFloor();
+        dest = PickOtherFloor(src);
+    }
+    else //a single non-lobby floor: the only trips are to and from the lobby
+    {
+        bool up = NextUniform() < 0.5;
+        src = up ? config.lobby : floors[0];
+        dest = up ? floors[0] : config.lobby;
+    }
+
+    req = ECElevatorSimRequest((int)time, src, dest);
+    return true;
+}
+
+const char* ECTrafficGenerator::GetPatternName(EC_TRAFFIC_PATTERN pattern)
+{
+    switch (pattern)
+    {
+    case EC_TRAFFIC_UP_PEAK: return "up-peak";
+    case EC_TRAFFIC_DOWN_PEAK: return "down-peak";
+    case EC_TRAFFIC_LUNCH: return "lunch";
+    default: return "uniform";
+    }
+}
+
+bool ECTrafficGenerator::ParsePattern(const std::string& name, EC_TRAFFIC_PATTERN& pattern)
+{
+    for (int p = EC_TRAFFIC_UNIFORM; p <= EC_TRAFFIC_LUNCH; p++)
+    {
+        if (name == GetPatternName((EC_TRAFFIC_PATTERN)p))
+        {
+            pattern = (EC_TRAFFIC_PATTERN)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+//*****************************************************************************
+// ECTrafficConfig
+
+bool ECTrafficConfig::Parse(const std::string& spec, std::string& error)
+{
+    istringstream in(spec);
+    string part;
+    getline(in, part, ':');
+    if (!ECTrafficGenerator::ParsePattern(part, pattern))
+    {
+        error = "unknown traffic pattern '" + part + "' (uniform, up-peak, down-peak, lunch)";
+        return false;
+    }
+
+    while (getline(in, part, ':'))
+    {
+        size_t eq = part.find('=');
+        string key = part.substr(0, eq);
+        string val = eq == string::npos ? "" : part.substr(eq + 1);
+        char* end = nullptr;
+        bool ok = !val.empty();
+        if (key == "floors") { numFloors = (int)strtol(val.c_str(), &end, 10); }
+        else if (key == "len") { lenSim = (int)strtol(val.c_str(), &end, 10); }
+        else if (key == "rate") { arrivalRate = strtod(val.c_str(), &end); }
+        else if (key == "seed") { seed = strtoull(val.c_str(), &end, 10); }
+        else if (key == "lobby") { lobby = (int)strtol(val.c_str(), &end, 10); }
+        else if (key == "share") { lobbyShare = strtod(val.c_str(), &end); }
+        else if (key == "weights")
+        {
+            floorWeights.clear();
+            istringstream list(val);
+            string w;
+            while (ok && getline(list, w, '/'))
+            {
+                floorWeights.push_back(strtod(w.c_str(), &end));
+                ok = end != w.c_str() && *end == '\0';
+            }
+            end = nullptr;
+        }
+        else
+        {
+            error = "unknown traffic setting '" + key + "'";
+            return false;
+        }
+        if (!ok || (end != nullptr && *end != '\0'))
+        {
+            error = "bad value for '" + key + "': " + val;
+            return false;
+        }
+    }
+
+    if (numFloors < 2 || lenSim < 0 || arrivalRate < 0 || lobby < 1 || lobby > numFloors)
+    {
+        error = "traffic needs floors >= 2, len >= 0, rate >= 0 and 1 <= lobby <= floors";
+        return false;
+    }
+    return true;
+}
+
+std::string ECTrafficConfig::ToString() const
+{
+    ostringstream out;
+    out << setprecision(numeric_limits<double>::max_digits10); //enough digits that Parse gets the same doubles back
+    out << ECTrafficGenerator::GetPatternName(pattern) << ":floors=" << numFloors << ":len=" << lenSim << ":rate=" << arrivalRate << ":seed=" << seed;
+    out << ":lobby=" << lobby << ":share=" << lobbyShare; //share isn't used by uniform traffic, but it's part of the config all the same
+    for (size_t i = 0; i < floorWeights.size(); i++)
+    {
+        out << (i ? "/" : ":weights=") << floorWeights[i];
+    }
+    return out.str();
+}
@@ -0,0 +1,76 @@
+//
+//  ECTrafficGenerator.h
+//
+
+#ifndef ECTrafficGenerator_h
+#define ECTrafficGenerator_h
+
+#include "ECElevatorSim.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//*****************************************************************************
+// Synthetic traffic
+// Requests arrive as a Poisson process (arrivalRate per tick on average) from time 0 to lenSim.
+// Where people come from and go to depends on the pattern:
+// (i) uniform: between any two floors, lobby included
+// (ii) up-peak (morning): lobbyShare of the trips start at the lobby and go up, the rest are interfloor
+// (iii) down-peak (evening): lobbyShare of the trips go down to the lobby, the rest are interfloor
+// (iv) lunch: lobbyShare split evenly between going to and coming back from the lobby, the rest interfloor
+// Other floors are picked by floorWeights (e.g. how many people work there)
+
+typedef enum
+{
+    EC_TRAFFIC_UNIFORM = 0,
+    EC_TRAFFIC_UP_PEAK,
+    EC_TRAFFIC_DOWN_PEAK,
+    EC_TRAFFIC_LUNCH
+} EC_TRAFFIC_PATTERN;
+
+struct ECTrafficConfig
+{
+    EC_TRAFFIC_PATTERN pattern = EC_TRAFFIC_UNIFORM;
+    int numFloors = 10;
+    int lenSim = 1000;
+    double arrivalRate = 0.1; //requests per tick
+    uint64_t seed = 1;
+    int lobby = 1;
+    double lobbyShare = 0.85;
+    std::vector<double> floorWeights; //index 0 is floor 1; empty: every floor the same
+
+    // "pattern[:key=value]..." with keys floors, len, rate, seed, lobby, share, weights (w1/w2/...)
+    // e.g. "up-peak:floors=30:len=3600:rate=0.5:seed=7"; false (with a reason in error) if it doesn't parse
+    bool Parse(const std::string& spec, std::string& error);
+    std::string ToString() const; //the spec back, every key spelled out (defaults too; weights only if set), doubles to full precision
+};
+
+class ECTrafficGenerator : public ECElevatorRequestSource
+{
+public:
+    ECTrafficGenerator(const ECTrafficConfig& config);
+
+    virtual bool Next(ECElevatorSimRequest& req) override; //time-sorted; false once past lenSim
+    virtual std::unique_ptr<ECElevatorRequestSource> Fork() const override { return std::unique_ptr<ECElevatorRequestSource>(new ECTrafficGenerator(*this)); } //same generator state, so the same requests follow
+
+    const ECTrafficConfig& GetConfig() const { return config; }
+
+    static const char* GetPatternName(EC_TRAFFIC_PATTERN pattern);
+    static bool ParsePattern(const std::string& name, EC_TRAFFIC_PATTERN& pattern);
+
+private:
+    uint64_t NextRandom(); //splitmix64
+    double NextUniform(); //[0, 1)
+    int PickFloor(); //floor by weight (alias method, O(1)); never the lobby unless uniform
+    int PickOtherFloor(int floor); //like PickFloor, but not floor
+    void BuildAliasTable();
+
+    ECTrafficConfig config;
+    uint64_t state;
+    double time;
+    std::vector<int> floors; //candidate floors for PickFloor
+    std::vector<double> aliasProb;
+    std::vector<int> alias;
+};
+
+#endif /* ECTrafficGenerator_h */
@@ -3,6 +3,7 @@
 #include <map>
 #include <string>
 #include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <allegro5/allegro_audio.h>
 #include <allegro5/allegro_acodec.h>
@@ -11,8 +12,8 @@
 // ECElevatorObserver Implementation
 //----------------------------------------------------------------------------------------------------------------------------
 ECElevatorObserver::ECElevatorObserver(ECGraphicViewImp& viewIn, int numFloors,
-    const std::vector<ECElevatorState>& allStates, int lenSim) :
-    view(viewIn), numFloors(numFloors), states(allStates), lenSim(lenSim),
+    ECElevatorStateFeed& feed, int lenSim) :
+    view(viewIn), numFloors(numFloors), feed(feed), lenSim(lenSim),
     paused(false), topFloorY(100), currentSimTime(0), currentFrame(0)
 {
     bottomFloorY = topFloorY + (numFloors - 1) * FLOOR_HEIGHT;
@@ -27,11 +28,24 @@ ECElevatorObserver::ECElevatorObserver(ECGraphicViewImp& viewIn, int numFloors,
     upArrowImage = ResourceFactory::loadBitmap("up_arrow.png");
     downArrowImage = ResourceFactory::loadBitmap("down_arrow.png");
 
+    //pre-scaled copies of the man, arrow and cabin images in one bitmap; frames draw from that
+    BuildSpriteAtlas();
+
     //create fonts from ResourceFactory
     jerseyFont = ResourceFactory::loadFont("jersey.ttf", 27);
     segmentedFont = ResourceFactory::loadFont("segmented.ttf", 60);
     displayFont = ResourceFactory::loadFont("MiguerSans-Regular.ttf", 50);
 
+    //render every label the view writes once; frames then blit them
+    labelCache.AddNumbers(jerseyFont.get(), ECGV_WHITE, 1, numFloors); //passengers' destinations
+    labelCache.AddNumbers(segmentedFont.get(), ECGV_RED, 1, numFloors); //floor on the screen
+    labelCache.AddString(segmentedFont.get(), ECGV_RED, "-");
+    labelCache.AddNumbers(displayFont.get(), ECGV_WHITE, 0, 9); //time is put together from digits
+    for (const char* text : { "Time: ", "Pause", "Resume", "Music On", "Music Off" })
+    {
+        labelCache.AddString(displayFont.get(), ECGV_WHITE, text);
+    }
+
     //create sound samples from ResourceFactory
     backgroundMusic = ResourceFactory::loadSample("elevator_music.ogg");
     dingSound = ResourceFactory::loadSample("ding.ogg");
@@ -67,17 +81,17 @@ void ECElevatorObserver::Update()
                 PlayAllMusic();
             }
             
-            //advance animation frame
-            if (currentSimTime < lenSim - 1)
+            //advance animation frame (holds still if the simulation hasn't reached the next tick yet)
+            if (currentSimTime < lenSim - 1 && feed.GetState(currentSimTime + 1) != nullptr)
             {
                 currentFrame++;
                 if (currentFrame == 1 && dingSoundInstance)
                 {
                     //elevator ding sound logic
-                    const ECElevatorState& prevState = states[currentSimTime];
-                    const ECElevatorState& currState = states[currentSimTime + 1];
-                    bool wasMoving = (prevState.dir == EC_ELEVATOR_UP || prevState.dir == EC_ELEVATOR_DOWN);
-                    bool isStoppedNow = currState.dir == EC_ELEVATOR_STOPPED;
+                    EC_ELEVATOR_DIR prevDir = feed.GetState(currentSimTime)->dir;
+                    EC_ELEVATOR_DIR currDir = feed.GetState(currentSimTime + 1)->dir;
+                    bool wasMoving = (prevDir == EC_ELEVATOR_UP || prevDir == EC_ELEVATOR_DOWN);
+                    bool isStoppedNow = currDir == EC_ELEVATOR_STOPPED;
                     if (wasMoving && isStoppedNow && musicOn) //only play when stops at a floor
                     {
                         al_play_sample_instance(dingSoundInstance.get());
@@ -88,6 +102,7 @@ void ECElevatorObserver::Update()
                 {
                     currentFrame = 0;
                     currentSimTime++;
+                    feed.ReleaseBefore(currentSimTime); //done with the tick just played
                 }
             }
 
@@ -157,7 +172,78 @@ bool ECElevatorObserver::IsInRect(int x, int y, const ALLEGRO_RECT& rect)
     return (x >= rect.left && y >= rect.top && x <= rect.right && y <= rect.bottom);
 }
 
-void ECElevatorObserver::DrawElevator()
+//copy each sprite into one atlas at the size it is drawn at, so drawing one is an unscaled blit from
+//a shared texture and a run of them can be batched
+void ECElevatorObserver::BuildSpriteAtlas()
+{
+    struct Entry { ALLEGRO_BITMAP* image; Sprite* sprite; int w; int h; };
+    int manH = FLOOR_HEIGHT / 1.5;
+    int manW = manImage ? int(al_get_bitmap_width(manImage.get()) * (double(manH) / al_get_bitmap_height(manImage.get()))) : 0;
+    Entry entries[] = {
+        { manImage.get(), &manSprite, manW, manH },
+        { upArrowImage.get(), &upArrowSprite, 40, 40 },
+        { downArrowImage.get(), &downArrowSprite, 40, 40 },
+        { elevatorImageCabin.get(), &cabinSprite, cabinWidth + 97, FLOOR_HEIGHT - 3 },
+    };
+
+    //one row, a pixel apart so filtering never picks up a neighbour
+    int atlasW = 0, atlasH = 0;
+    for (Entry& entry : entries)
+    {
+        if (!entry.image) { continue; } //failed to load: sprite stays empty
+        *entry.sprite = Sprite{ atlasW, 0, entry.w, entry.h };
+        atlasW += entry.w + 1;
+        atlasH = std::max(atlasH, entry.h);
+    }
+    if (atlasW == 0) { return; }
+
+    spriteAtlas = std::shared_ptr<ALLEGRO_BITMAP>(al_create_bitmap(atlasW, atlasH), al_destroy_bitmap);
+    if (!spriteAtlas)
+    {
+        std::cout << "Failed to create the sprite atlas" << std::endl;
+        return;
+    }
+    ALLEGRO_BITMAP* prevTarget = al_get_target_bitmap();
+    al_set_target_bitmap(spriteAtlas.get());
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+    for (Entry& entry : entries)
+    {
+        if (!entry.image) { continue; }
+        al_draw_scaled_bitmap(entry.image, 0, 0, al_get_bitmap_width(entry.image), al_get_bitmap_height(entry.image),
+            entry.sprite->x, entry.sprite->y, entry.w, entry.h, 0);
+    }
+    al_set_target_bitmap(prevTarget);
+}
+
+void ECElevatorObserver::DrawSprite(const Sprite& sprite, int x, int y)
+{
+    if (!spriteAtlas || sprite.w == 0) { return; }
+    al_draw_bitmap_region(spriteAtlas.get(), sprite.x, sprite.y, sprite.w, sprite.h, x, y, 0);
+}
+
+//pre-render the parts of the scene that don't change into an offscreen bitmap; redone only if the view size or floor count changes
+void ECElevatorObserver::BuildStaticLayer()
+{
+    staticLayerWidth = view.GetWidth();
+    staticLayerHeight = view.GetHeight();
+    staticLayerFloors = numFloors;
+    staticLayer = std::shared_ptr<ALLEGRO_BITMAP>(al_create_bitmap(staticLayerWidth, staticLayerHeight), al_destroy_bitmap);
+    if (!staticLayer)
+    {
+        std::cout << "Failed to create the background layer, drawing it every frame" << std::endl;
+        return;
+    }
+
+    ALLEGRO_BITMAP* prevTarget = al_get_target_bitmap();
+    al_set_target_bitmap(staticLayer.get());
+    al_clear_to_color(al_map_rgb(255, 255, 255)); //what the view clears to each frame
+    DrawStaticScene();
+    al_set_target_bitmap(prevTarget);
+}
+
+//background, shaft, doors, unlit call buttons and the display's frame
+//(the progress bar and pause/music buttons stay per frame: in short buildings they overlap the time label and passengers)
+void ECElevatorObserver::DrawStaticScene()
 {
     if (elevatorImageBack)
     {
@@ -169,40 +255,74 @@ void ECElevatorObserver::DrawElevator()
     //draw border around elevator
     view.DrawRectangle(view.GetWidth()/2 - 100, topFloorY, view.GetWidth()/2 + 100, bottomFloorY + FLOOR_HEIGHT, 5, ECGV_WHITE);
 
-    const ECElevatorState& st = states[currentSimTime];
-
-    //draw floor images, font, and buttons
+    //draw floor images and buttons
+    int shaftW = al_get_bitmap_width(shaftImage.get());
+    int shaftH = al_get_bitmap_height(shaftImage.get());
     for (int floor = 1; floor <= numFloors; floor++)
     {
         int y = bottomFloorY - (floor - 1) * FLOOR_HEIGHT;
 
         //shaft door images
-        int shaftW = al_get_bitmap_width(shaftImage.get());
-        int shaftH = al_get_bitmap_height(shaftImage.get());
         al_draw_scaled_bitmap(shaftImage.get(), 0, 0, shaftW, shaftH, view.GetWidth() / 2 - 100, y, 200, FLOOR_HEIGHT, 0);
 
         //button variables
         int buttonBaseX = view.GetWidth() / 2 + 50;
         int floorMidY = y + FLOOR_HEIGHT / 2 - 5;
-        ECGVColor upColor = ECGV_SILVER;
-        ECGVColor downColor = ECGV_SILVER;
-
-        if (st.waitingMap.count(floor) > 0) //if there are ppl waiting at the floor
-        {
-            for (const auto& info : st.waitingMap.at(floor))
-            {
-                if (info.goingUp) upColor = ECGV_RED;
-                else downColor = ECGV_RED;
-            }
-        }
 
         //draw back plate for buttons
         view.DrawRectangle(buttonBaseX - 9, floorMidY - 14, buttonBaseX + 9, floorMidY + 14, 1, ECGV_WHITE);
         view.DrawFilledRectangle(buttonBaseX - 8, floorMidY - 13, buttonBaseX + 8, floorMidY + 13, ECGV_BLACK);
-        
-        //draw triangle buttons
-        view.DrawFilledTriangle(buttonBaseX, floorMidY - 8, buttonBaseX + 6, floorMidY - 2, buttonBaseX - 6, floorMidY - 2, upColor);
-        view.DrawFilledTriangle(buttonBaseX, floorMidY + 8, buttonBaseX + 6, floorMidY + 2, buttonBaseX - 6, floorMidY + 2, downColor);
+
+        //draw triangle buttons, unlit
+        view.DrawFilledTriangle(buttonBaseX, floorMidY - 8, buttonBaseX + 6, floorMidY - 2, buttonBaseX - 6, floorMidY - 2, ECGV_SILVER);
+        view.DrawFilledTriangle(buttonBaseX, floorMidY + 8, buttonBaseX + 6, floorMidY + 2, buttonBaseX - 6, floorMidY + 2, ECGV_SILVER);
+    }
+
+    //elevator screen: outer rectangle border and black inner fill
+    int screenX = view.GetWidth()/2 - SCREEN_WIDTH - 250;
+    int screenY = topFloorY + 200;
+    view.DrawRectangle(screenX - 2, screenY - 2, screenX + SCREEN_WIDTH + 2, screenY + SCREEN_HEIGHT + 2, 3, ECGV_GREY);
+    view.DrawFilledRectangle(screenX, screenY, screenX + SCREEN_WIDTH, screenY + SCREEN_HEIGHT, ECGV_BLACK);
+}
+
+void ECElevatorObserver::DrawElevator()
+{
+    //everything that never changes comes from the cached layer
+    if (staticLayerWidth != view.GetWidth() || staticLayerHeight != view.GetHeight() || staticLayerFloors != numFloors)
+    {
+        BuildStaticLayer();
+    }
+    if (staticLayer)
+    {
+        al_draw_bitmap(staticLayer.get(), 0, 0, 0);
+    }
+    else //couldn't get an offscreen bitmap, so draw it all as before
+    {
+        DrawStaticScene();
+    }
+
+    static const ECElevatorState noState; //before the first tick is simulated: empty building
+    const ECElevatorState* currState = feed.GetState(currentSimTime);
+    const ECElevatorState& st = currState ? *currState : noState;
+
+    //light up the call buttons of floors where ppl wait (the unlit ones are in the static layer)
+    for (const auto& waiting : st.waitingMap)
+    {
+        int floor = waiting.first;
+        if (floor < 1 || floor > numFloors) { continue; }
+        bool upLit = false;
+        bool downLit = false;
+        for (const auto& info : waiting.second)
+        {
+            if (info.goingUp) upLit = true;
+            else downLit = true;
+        }
+
+        int y = bottomFloorY - (floor - 1) * FLOOR_HEIGHT;
+        int buttonBaseX = view.GetWidth() / 2 + 50;
+        int floorMidY = y + FLOOR_HEIGHT / 2 - 5;
+        if (upLit) view.DrawFilledTriangle(buttonBaseX, floorMidY - 8, buttonBaseX + 6, floorMidY - 2, buttonBaseX - 6, floorMidY - 2, ECGV_RED);
+        if (downLit) view.DrawFilledTriangle(buttonBaseX, floorMidY + 8, buttonBaseX + 6, floorMidY + 2, buttonBaseX - 6, floorMidY + 2, ECGV_RED);
     }
 
     DrawElevatorScreen(st);
@@ -210,16 +330,22 @@ void ECElevatorObserver::DrawElevator()
     //update cabin position frame by frame
     int prevFloor = st.floor;
     int prevY = bottomFloorY - (prevFloor - 1) * FLOOR_HEIGHT;
-    int nextFloor = (currentSimTime < lenSim - 1) ? states[currentSimTime + 1].floor : prevFloor;
+    const ECElevatorState* nextState = (currentSimTime < lenSim - 1) ? feed.GetState(currentSimTime + 1) : nullptr;
+    int nextFloor = nextState ? nextState->floor : prevFloor;
     int nextY = bottomFloorY - (nextFloor - 1) * FLOOR_HEIGHT;
     double t = double(currentFrame)/FRAMES_PER_STEP;
     cabinY = (int)(prevY + (nextY - prevY) * t);
 
     DrawElevatorCabin();
 
-    DrawWaitingPassengers(st);
-
-    DrawOnboardPassengers(st);
+    //every man comes from the atlas and every label from the label cache's sheet, so with drawing held
+    //they go out as two batches, however many ppl there are
+    al_hold_bitmap_drawing(true);
+    DrawWaitingPassengers(st, false);
+    DrawOnboardPassengers(st, false);
+    DrawWaitingPassengers(st, true);
+    DrawOnboardPassengers(st, true);
+    al_hold_bitmap_drawing(false);
 
     DrawTimeAndProgressBar();
 
@@ -234,7 +360,7 @@ void ECElevatorObserver::DrawButtons()
     const char* labelPause = paused ? "Resume" : "Pause";
     int midX = (pauseBtnRect.left + pauseBtnRect.right) / 2;
     int midY = (pauseBtnRect.top + pauseBtnRect.bottom) / 2;
-    view.DrawTextFont(midX , midY - 30, labelPause, ECGV_WHITE, displayFont.get());
+    labelCache.Draw(displayFont.get(), ECGV_WHITE, labelPause, midX, midY - 30);
 
     view.DrawFilledRectangle(musicBtnRect.left, musicBtnRect.top, musicBtnRect.right, musicBtnRect.bottom, ECGV_DARK_GREY);
     view.DrawRectangle(musicBtnRect.left, musicBtnRect.top,musicBtnRect.right, musicBtnRect.bottom, 3, ECGV_BLACK);
@@ -242,67 +368,52 @@ void ECElevatorObserver::DrawButtons()
     const char* labelMusic = musicOn ? "Music On" : "Music Off";
     int midX2 = (musicBtnRect.left + musicBtnRect.right) / 2;
     int midY2 = (musicBtnRect.top + musicBtnRect.bottom) / 2;
-    view.DrawTextFont(midX2, midY2 - 30, labelMusic, ECGV_WHITE, displayFont.get());
+    labelCache.Draw(displayFont.get(), ECGV_WHITE, labelMusic, midX2, midY2 - 30);
 }
 
 void ECElevatorObserver::DrawElevatorScreen(const ECElevatorState& st)
 {
-    //constants
-    int screenWidth = 130;
-    int screenHeight = 90;
+    //constants (the screen's frame and fill are in the static layer)
+    int screenWidth = SCREEN_WIDTH;
+    int screenHeight = SCREEN_HEIGHT;
     int screenX = view.GetWidth()/2 - screenWidth - 250;
     int screenY = topFloorY + 200;
 
-    //draw outer rectangle border
-    view.DrawRectangle(screenX - 2, screenY - 2, screenX + screenWidth + 2, screenY + screenHeight + 2, 3, ECGV_GREY);
-
-    //draw black inner fill
-    view.DrawFilledRectangle(screenX, screenY, screenX + screenWidth, screenY + screenHeight, ECGV_BLACK);
-
     //logic for screen's up or down arrow
     EC_ELEVATOR_DIR direction = st.dir;
-    if (direction == EC_ELEVATOR_UP && upArrowImage)
+    if (direction == EC_ELEVATOR_UP && upArrowSprite.w > 0)
     {
-        al_draw_scaled_bitmap(upArrowImage.get(), 0, 0, al_get_bitmap_width(upArrowImage.get()), al_get_bitmap_height(upArrowImage.get()),
-            screenX + 20, screenY + (screenHeight - 40) / 2, 40, 40, 0);
+        DrawSprite(upArrowSprite, screenX + 20, screenY + (screenHeight - 40) / 2);
     }
-    else if (direction == EC_ELEVATOR_DOWN && downArrowImage)
+    else if (direction == EC_ELEVATOR_DOWN && downArrowSprite.w > 0)
     {
-        al_draw_scaled_bitmap(downArrowImage.get(), 0, 0, al_get_bitmap_width(downArrowImage.get()), al_get_bitmap_height(downArrowImage.get()),
-            screenX + 20, screenY + (screenHeight - 40) / 2, 40, 40, 0);
+        DrawSprite(downArrowSprite, screenX + 20, screenY + (screenHeight - 40) / 2);
     }
     else
     {
-        view.DrawTextFont(screenX + 45, screenY + (screenHeight / 2) - 30, "-", ECGV_RED, segmentedFont.get());
+        labelCache.Draw(segmentedFont.get(), ECGV_RED, "-", screenX + 45, screenY + (screenHeight / 2) - 30);
     }
 
     //write curent floor in segmented font
-    std::string floorText = std::to_string(st.floor);
-    view.DrawTextFont(screenX + 100, screenY + (screenHeight / 2) - 30, floorText.c_str(), ECGV_RED, segmentedFont.get());
+    labelCache.Draw(segmentedFont.get(), ECGV_RED, st.floor, screenX + 100, screenY + (screenHeight / 2) - 30);
 }
 
 void ECElevatorObserver::DrawElevatorCabin()
 {
-    int w = al_get_bitmap_width(elevatorImageCabin.get());
-    int h = al_get_bitmap_height(elevatorImageCabin.get());
-
     int cabinWidth = 100;
     int cabinHeight = FLOOR_HEIGHT;
 
-    al_draw_scaled_bitmap(elevatorImageCabin.get(), 0, 0, w, h, cabinX - 99, cabinY + 1, cabinWidth + 97, cabinHeight - 3, 0);
+    DrawSprite(cabinSprite, cabinX - 99, cabinY + 1);
     view.DrawRectangle(cabinX - 99, cabinY + 1, cabinX - 99 + cabinWidth + 97, cabinY + 1 + cabinHeight - 3, 4, ECGV_BLACK);
     
 }
 
-void ECElevatorObserver::DrawOnboardPassengers(const ECElevatorState& st)
+//labels false: the men; true: the destination written on each (separate passes so each is one batch)
+void ECElevatorObserver::DrawOnboardPassengers(const ECElevatorState& st, bool labels)
 {
     int xStart = cabinX - 100;
     int yStart = cabinY + 25;
-    int manW = al_get_bitmap_width(manImage.get());
-    int manH = al_get_bitmap_height(manImage.get());
-    int scaledH = FLOOR_HEIGHT / 1.5;
-    double scaleFactor = double(scaledH) / double(manH);
-    int scaledW = int(manW * scaleFactor);
+    int scaledW = manSprite.w;
 
     //for each onboard passenger
     for (int i = 0; i < st.onboard.size(); i++)
@@ -310,18 +421,20 @@ void ECElevatorObserver::DrawOnboardPassengers(const ECElevatorState& st)
         int px = xStart + i * (scaledW * 0.5);
         int py = yStart;
 
-        al_draw_scaled_bitmap(manImage.get(), 0, 0, manW, manH, px, py, scaledW, scaledH, 0); //draw man image
-
-        //draw floor destination for this passenger
-        std::string dest = std::to_string(st.onboard[i].destFloor);
-        view.DrawTextFont(px + (scaledW / 2), py + 15, dest.c_str(), ECGV_WHITE, jerseyFont.get());
+        if (!labels)
+        {
+            DrawSprite(manSprite, px, py); //draw man image
+        }
+        else //draw floor destination for this passenger
+        {
+            labelCache.Draw(jerseyFont.get(), ECGV_WHITE, st.onboard[i].destFloor, px + (scaledW / 2), py + 15);
+        }
     }
 }
 
 void ECElevatorObserver::DrawTimeAndProgressBar()
 {
-    std::string timeText = "Time: " + std::to_string(currentSimTime);
-    view.DrawTextFont(285, bottomFloorY - 70, timeText.c_str(), ECGV_WHITE, displayFont.get());
+    labelCache.Draw(displayFont.get(), ECGV_WHITE, "Time: ", currentSimTime, 285, bottomFloorY - 70);
 
     int barX = 150;
     int barY = bottomFloorY - 100;
@@ -334,33 +447,32 @@ void ECElevatorObserver::DrawTimeAndProgressBar()
     view.DrawFilledRectangle(barX + 1, barY + 2, barX + filledWidth - 2, barY + barHeight - 2, ECGV_WHITE);
 }
 
-void ECElevatorObserver::DrawWaitingPassengers(const ECElevatorState& st)
+//labels false: the men; true: where each is going
+void ECElevatorObserver::DrawWaitingPassengers(const ECElevatorState& st, bool labels)
 {
-    for (int floorNum = 1; floorNum <= numFloors; floorNum++) //for each floor
+    int baseX = view.GetWidth() / 2 + 90;
+    int scaledW = manSprite.w;
+    int scaledH = manSprite.h;
+    for (const auto& waiting : st.waitingMap) //for each floor with ppl to draw
     {
+        int floorNum = waiting.first;
         int y = bottomFloorY - (floorNum - 2) * FLOOR_HEIGHT; //position to draw person at
+        int count = 0;
 
-        if (st.waitingMap.count(floorNum) > 0) //if there are ppl to draw
-        {            
-            int baseX = view.GetWidth() / 2 + 90;
-            int manW = al_get_bitmap_width(manImage.get());
-            int manH = al_get_bitmap_height(manImage.get());
-            int scaledH = FLOOR_HEIGHT / 1.5;
-            double scaleFactor = double(scaledH) / double(manH);
-            int scaledW = int(manW * scaleFactor);
-            int count = 0;
-
-            for (auto& reqInfo : st.waitingMap.at(floorNum)) //for each person in RequestInfo on this floor
-            {
-                count++;
-                int px = baseX + count * (scaledW * 0.5);
-                int py = y - scaledH;
-                
-                al_draw_scaled_bitmap(manImage.get(), 0, 0, manW, manH, px, py, scaledW, scaledH, 0);
+        for (auto& reqInfo : waiting.second) //for each person in RequestInfo on this floor
+        {
+            count++;
+            int px = baseX + count * (scaledW * 0.5);
+            int py = y - scaledH;
 
-                std::string destStr = std::to_string(reqInfo.destFloor);
-                view.DrawTextFont(px + scaledW/2, py + 15, destStr.c_str(), ECGV_WHITE, jerseyFont.get()); //write underneath where they are going
+            if (!labels)
+            {
+                DrawSprite(manSprite, px, py);
+            }
+            else
+            {
+                labelCache.Draw(jerseyFont.get(), ECGV_WHITE, reqInfo.destFloor, px + scaledW/2, py + 15); //write underneath where they are going
             }
         }
     }
-}
\ No newline at end of file
+}
@@ -5,6 +5,8 @@
 #include "ECObserver.h"
 #include "ECGraphicViewImp.h"
 #include "ECElevatorSim.h"
+#include "ECElevatorStateFeed.h"
+#include "ECLabelCache.h"
 #include <allegro5/allegro_audio.h>
 #include <allegro5/allegro_acodec.h>
 
@@ -79,8 +81,8 @@ struct ALLEGRO_RECT
 class ECElevatorObserver : public ECObserver
 {
 public:
-    //constructor
-    ECElevatorObserver(ECGraphicViewImp& viewIn, int numFloors, const std::vector<ECElevatorState>& allStates, int lenSim);
+    //constructor; states come from the feed as the simulation produces them
+    ECElevatorObserver(ECGraphicViewImp& viewIn, int numFloors, ECElevatorStateFeed& feed, int lenSim);
 
     //defualt deconstructor since shared pointers deallocate automatically
     virtual ~ECElevatorObserver() = default;
@@ -97,9 +99,12 @@ private:
 
     //draw helper methods
     void DrawElevator();
+    void BuildStaticLayer();
+    void BuildSpriteAtlas();
+    void DrawStaticScene();
     void DrawTimeAndProgressBar();
-    void DrawWaitingPassengers(const ECElevatorState& st);
-    void DrawOnboardPassengers(const ECElevatorState& st);
+    void DrawWaitingPassengers(const ECElevatorState& st, bool labels);
+    void DrawOnboardPassengers(const ECElevatorState& st, bool labels);
     void DrawElevatorScreen(const ECElevatorState& st);
     void DrawElevatorCabin();
     void DrawButtons();
@@ -114,6 +119,8 @@ private:
     static constexpr int FRAMES_PER_STEP = 65;
     static const int cabinWidth = 100;
     static const int cabinHeight = 100;
+    static const int SCREEN_WIDTH = 130;
+    static const int SCREEN_HEIGHT = 90;
 
     //elevator variables
     int numFloors;
@@ -127,7 +134,7 @@ private:
     bool paused;
     int currentFrame;
     int currentSimTime;
-    const std::vector<ECElevatorState>& states;
+    ECElevatorStateFeed& feed; //ticks not played yet; played ones are handed back
 
     //state button
     bool musicOn = true;
@@ -151,9 +158,30 @@ private:
     std::shared_ptr<ALLEGRO_BITMAP> upArrowImage;
     std::shared_ptr<ALLEGRO_BITMAP> downArrowImage;
 
+    //sprites (man, arrows, cabin) at their on-screen size, packed into spriteAtlas
+    struct Sprite
+    {
+        int x = 0, y = 0, w = 0, h = 0; //w == 0: image didn't load
+    };
+    void DrawSprite(const Sprite& sprite, int x, int y);
+    std::shared_ptr<ALLEGRO_BITMAP> spriteAtlas;
+    Sprite manSprite;
+    Sprite upArrowSprite;
+    Sprite downArrowSprite;
+    Sprite cabinSprite;
+
+    //scene parts that never change, pre-rendered; rebuilt if the view size or floor count changes
+    std::shared_ptr<ALLEGRO_BITMAP> staticLayer;
+    int staticLayerWidth = 0;
+    int staticLayerHeight = 0;
+    int staticLayerFloors = 0;
+
     //font shared pointer variables
     std::shared_ptr<ALLEGRO_FONT> jerseyFont;
     std::shared_ptr<ALLEGRO_FONT> segmentedFont;  
     std::shared_ptr<ALLEGRO_FONT> displayFont;
+
+    //floor numbers and button captions pre-rendered in those fonts (declared after them: holds their pointers)
+    ECLabelCache labelCache;
 };
 #endif /* ElevatorObserver_h */
\ No newline at end of file
@@ -1,89 +1,264 @@
 #include "ElevatorObserver.h"
 #include "ECGraphicViewImp.h"
 #include "ECElevatorSim.h"
-#include <fstream>
+#include "ECElevatorTrace.h"
+#include "ECElevatorHeadless.h"
+#include "ECElevatorStateFeed.h"
+#include "ECScenarioRunner.h"
+#include "ECTrafficGenerator.h"
 #include <iostream>
+#include <fstream>
 #include <sstream>
 #include <algorithm>
 #include <string>
+#include <cstdlib>
+#include <memory>
+#include <chrono>
 
-int main(int argc, char *argv[])
+//print problems found while loading a trace (bad lines are skipped, not fatal)
+static void ReportTraceErrors(const std::string& filename, const std::vector<ECTraceError>& errors, int numErrors)
 {
-
-    std::string filename; //get filename from the first command line arguement
-
-    //if command line arguements, then use the filename, else hardcode to test1.txt
-    if (argc > 1)
+    for (auto& err : errors)
     {
-        filename = argv[1];
+        if (err.line > 0) { std::cerr << filename << ":" << err.line << ": "; }
+        std::cerr << err.message << std::endl;
     }
-    else
+    if (numErrors > (int)errors.size())
     {
-        filename = "test1.txt";
+        std::cerr << "(" << numErrors - (int)errors.size() << " more errors)" << std::endl;
     }
+}
 
-    std::ifstream inFile(filename); //open file
-    if (!inFile.is_open()) //make sure we can open the file
+//--batch [--threads N] [--cars N,N,...] [--policies name,name,...] [--csv file] [--json file] trace...  (a trace can also be gen:<traffic spec>)
+//runs every trace with every bank size and direction policy on a thread pool and writes one report (JSON to stdout if no file given)
+static int RunBatch(int argc, char *argv[])
+{
+    int numThreads = 0;
+    std::vector<int> carCounts;
+    std::vector<EC_DIRECTION_POLICY> policies;
+    std::string csvFile, jsonFile;
+    std::vector<std::string> traces;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) { numThreads = std::atoi(argv[++i]); }
+        else if (arg == "--csv" && i + 1 < argc) { csvFile = argv[++i]; }
+        else if (arg == "--json" && i + 1 < argc) { jsonFile = argv[++i]; }
+        else if (arg == "--cars" && i + 1 < argc)
+        {
+            std::istringstream list(argv[++i]);
+            std::string num;
+            while (std::getline(list, num, ',')) { carCounts.push_back(std::max(1, std::atoi(num.c_str()))); }
+        }
+        else if (arg == "--policies" && i + 1 < argc)
+        {
+            std::istringstream list(argv[++i]);
+            std::string name;
+            while (std::getline(list, name, ','))
+            {
+                EC_DIRECTION_POLICY policy;
+                if (!ECElevatorDirectionPolicy::Parse(name, policy))
+                {
+                    std::cerr << "unknown direction policy: " << name << " (classic, nearest, look or scan)" << std::endl;
+                    return 1;
+                }
+                policies.push_back(policy);
+            }
+        }
+        else { traces.push_back(arg); }
+    }
+    if (traces.empty())
     {
-        std::cerr << "Can't open file: " << filename << std::endl;
+        std::cerr << "--batch needs at least one trace file" << std::endl;
         return 1;
     }
-    
+    if (carCounts.empty()) { carCounts.push_back(1); }
+    if (policies.empty()) { policies.push_back(EC_POLICY_CLASSIC); }
 
-    int numFloors = 0;
-    int lenSim = 0;
-    
-    std::string line;
-    while (std::getline(inFile, line))
+    ECScenarioRunner runner(numThreads);
+    for (auto& trace : traces)
     {
-        if (line.empty() || line[0] == '#') //dont read comments
+        for (int numCars : carCounts)
         {
-            continue;
+            for (EC_DIRECTION_POLICY policy : policies)
+            {
+                runner.Add(ECScenario{ trace, numCars, policy });
+            }
         }
-        std::istringstream iss(line);
-        if (!(iss >> numFloors >> lenSim))
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const std::vector<ECScenarioResult>& results = runner.Run();
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if (!csvFile.empty())
+    {
+        std::ofstream out(csvFile);
+        ECScenarioRunner::WriteCSV(out, results);
+    }
+    if (!jsonFile.empty())
+    {
+        std::ofstream out(jsonFile);
+        ECScenarioRunner::WriteJSON(out, results, totalMs, runner.GetNumThreads());
+    }
+    if (csvFile.empty() && jsonFile.empty())
+    {
+        ECScenarioRunner::WriteJSON(std::cout, results, totalMs, runner.GetNumThreads());
+    }
+
+    int numFailed = (int)std::count_if(results.begin(), results.end(), [](const ECScenarioResult& res) { return !res.ok; });
+    std::cerr << results.size() << " scenarios on " << runner.GetNumThreads() << " threads in " << totalMs << " ms";
+    if (numFailed > 0) { std::cerr << " (" << numFailed << " failed to load)"; }
+    std::cerr << std::endl;
+    return numFailed > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+
+    std::string filename; //get filename from the first command line arguement
+
+    if (argc > 3 && std::string(argv[1]) == "--convert") //text trace -> binary trace and quit
+    {
+        std::vector<ECTraceError> errors;
+        bool converted = ECElevatorBinaryTrace::Convert(argv[2], argv[3], errors);
+        ReportTraceErrors(argv[2], errors, (int)errors.size());
+        return converted ? 0 : 1;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--generate") //synthetic traffic -> trace file and quit
+    {
+        ECTrafficConfig config;
+        std::string error;
+        if (!config.Parse(argv[2], error))
         {
-            std::cerr << "Full arguements not given" << std::endl;
+            std::cerr << error << std::endl;
             return 1;
         }
-        break;
-
+        ECTrafficGenerator generator(config);
+        if (!ECElevatorTraceWriter::Write(argv[3], config.numFloors, config.lenSim, generator))
+        {
+            std::cerr << "can't write file: " << argv[3] << std::endl;
+            return 1;
+        }
+        std::cerr << "wrote " << argv[3] << " from gen:" << config.ToString() << std::endl; //full spec, to regenerate it exactly
+        return 0;
     }
-    std::vector<ECElevatorSimRequest> requests;
-    while (std::getline(inFile, line)) //while theres lines
+    if (argc > 1 && std::string(argv[1]) == "--batch") //many traces/configs in parallel, no GUI
     {
-        if (line.empty() || line[0] == '#')
+        return RunBatch(argc, argv);
+    }
+    //--headless: run without the GUI (Allegro is never touched) and print a summary
+    //--results: with --headless, also print one CSV line per request
+    //--cars N: with --headless, simulate a bank of N cars
+    //--policy name: direction policy (classic, nearest, look or scan)
+    //--save-at T file: with --headless, write a checkpoint once T ticks are simulated, then carry on
+    //--resume file: with --headless, start from a checkpoint taken on the same trace and settings
+    bool headless = false;
+    bool results = false;
+    int numCars = 1;
+    EC_DIRECTION_POLICY policy = EC_POLICY_CLASSIC;
+    int saveAt = -1;
+    std::string saveFile, resumeFile;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless") { headless = true; }
+        else if (arg == "--results") { results = true; }
+        else if (arg == "--cars" && i + 1 < argc) { numCars = std::max(1, std::atoi(argv[++i])); }
+        else if (arg == "--save-at" && i + 2 < argc)
         {
-            continue; // skip comment lines
+            saveAt = std::max(0, std::atoi(argv[++i]));
+            saveFile = argv[++i];
         }
-        std::istringstream iss(line);
-        int t, src, dest; 
-        if (iss >> t >> src >> dest)
+        else if (arg == "--resume" && i + 1 < argc) { resumeFile = argv[++i]; }
+        else if (arg == "--policy" && i + 1 < argc)
         {
-            ECElevatorSimRequest req(t, src, dest); //create request and add to vector
-            requests.push_back(req);
+            if (!ECElevatorDirectionPolicy::Parse(argv[++i], policy))
+            {
+                std::cerr << "unknown direction policy: " << argv[i] << " (classic, nearest, look or scan)" << std::endl;
+                return 1;
+            }
         }
+        else if (filename.empty()) { filename = arg; }
     }
 
-    inFile.close(); //close file
+    //if command line arguements, then use the filename, else hardcode to test1.txt
+    if (filename.empty())
+    {
+        filename = "test1.txt";
+    }
 
-    //sorting requests by time
-    std::sort(requests.begin(), requests.end(), [](const ECElevatorSimRequest& a, const ECElevatorSimRequest& b){
-        return a.GetTime() < b.GetTime();
-        });
+    ECElevatorTraceInput trace; //binary traces are read in place; text ones are memory mapped, parsed and sorted (streamed when headless and in order)
+    bool loaded = trace.Open(filename, headless);
+    ReportTraceErrors(filename, trace.GetErrors(), trace.GetNumErrors());
+    if (!loaded)
+    {
+        return 1;
+    }
+    int numFloors = trace.GetNumFloors();
+    int lenSim = trace.GetLenSim();
+    ECElevatorRequestSource& source = trace.GetSource();
 
-    //running backend simulation first by itself
-    ECElevatorSim sim(numFloors, requests); //create object and send request to backend
-    sim.Simulate(lenSim); //simulate using object
+    if (numCars > 1 && !headless)
+    {
+        std::cerr << "--cars needs --headless (the view shows a single car)" << std::endl;
+        return 1;
+    }
+    if ((saveAt >= 0 || !resumeFile.empty()) && !headless)
+    {
+        std::cerr << "--save-at and --resume need --headless" << std::endl;
+        return 1;
+    }
+
+    if (headless)
+    {
+        ECElevatorResultCollector collector(source, results ? &std::cout : nullptr);
+        ECElevatorSim sim(numFloors, numCars, collector);
+        sim.SetRecordHistory(false); //nobody plays it back
+        sim.SetDirectionPolicy(policy);
+
+        if (!resumeFile.empty())
+        {
+            std::ifstream in(resumeFile, std::ios::binary);
+            std::string error = "can't open file";
+            if (!in || !sim.RestoreCheckpoint(in, error))
+            {
+                std::cerr << resumeFile << ": " << error << std::endl;
+                return 1;
+            }
+        }
+
+        if (results) { ECElevatorResultCollector::PrintHeader(std::cout); }
+        auto start = std::chrono::steady_clock::now();
+        if (saveAt >= sim.GetCurrTime() && saveAt < lenSim)
+        {
+            sim.SimulateEventDriven(saveAt);
+            std::ofstream out(saveFile, std::ios::binary);
+            if (!out || !sim.SaveCheckpoint(out))
+            {
+                std::cerr << "can't write file: " << saveFile << std::endl;
+                return 1;
+            }
+        }
+        sim.SimulateEventDriven(lenSim);
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        collector.PrintUnfinished(sim);
+
+        collector.PrintSummary(results ? std::cerr : std::cout, sim, lenSim, elapsedMs); //keep stdout pure CSV with --results
+        return 0;
+    }
 
-    //use new code to get state at each time step
-    const std::vector<ECElevatorState>& allStates = sim.GetAllStates();
+    //backend simulation runs on a worker thread alongside the view, a bounded number of ticks ahead of it
+    ECElevatorSim sim(numFloors, source); //create object and send request to backend
+    sim.SetDirectionPolicy(policy);
+    sim.SetRecordHistory(false); //the feed builds each tick's state as it goes
 
     //create view
     ECGraphicViewImp view(1200, 1100);
 
-    //use new code to feed states to frontend
-    ECElevatorObserver elevator(view, numFloors, allStates, lenSim);    
+    //states go through the feed to the frontend, so playback starts right away
+    ECElevatorStateFeed feed(sim, lenSim);
+    ECElevatorObserver elevator(view, numFloors, feed, lenSim);    
 
     view.Attach(&elevator);
     